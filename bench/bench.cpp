@@ -0,0 +1,268 @@
+#include <new>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+
+#include "profile.h"
+#include "argument.h"
+#include "tokenize.h"
+
+/*
+ * c--bench: lexer throughput on generated translation units.
+ *
+ *   c--bench [-s MB[,MB...]] [-n iterations] [-f filter]
+ *
+ * Every generator is run at every size, the best of n runs is reported.
+ */
+
+namespace {
+
+std::atomic<uint64_t> heapallocs {0};
+
+// small deterministic PRNG so inputs are identical across runs
+class Rand
+{
+public:
+    uint32_t Next()
+    {
+        m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return m_state >> 33;
+    }
+
+    uint32_t Below(uint32_t n) { return Next() % n; }
+
+private:
+    uint64_t m_state = 0x2545F4914F6CDD1DULL;
+};
+
+void Ident(Rand& r, std::string& out)
+{
+    static const char first[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ_";
+    static const char rest[] = "abcdefghijklmnopqrstuvwxyz0123456789_";
+
+    out += first[r.Below(sizeof(first) - 1)];
+    for (uint32_t i = r.Below(12); i > 0; i--)
+    {
+        out += rest[r.Below(sizeof(rest) - 1)];
+    }
+}
+
+// long names in declarations and calls
+void GenIdents(Rand& r, std::string& out)
+{
+    out += "static ";
+    Ident(r, out);
+    out += " ";
+    Ident(r, out);
+    out += " = ";
+    Ident(r, out);
+    out += "(";
+    Ident(r, out);
+    out += ", ";
+    Ident(r, out);
+    out += ");\n";
+}
+
+// the literal forms of tests/1.c
+void GenLiterals(Rand& r, std::string& out)
+{
+    static const char *lits[] = {
+        "'\\xff'", "'\\777'", "'\\0'", "'\\xffab'", "'\\n'", "' '",
+        "\"Hello World!\\\"xxx\\\"\\'\\';+-*/\"",
+        "0", "111111L", "12874892378426837462LL", "0777LLU", "0XFFFFabcdefULL",
+        "1.2345", ".01234F", "1.2345e3", "345.12345678L",
+    };
+
+    out += "x = ";
+    out += lits[r.Below(sizeof(lits) / sizeof(lits[0]))];
+    out += ";\n";
+}
+
+// operators and separators only, separated so no "/*" appears
+void GenPuncts(Rand& r, std::string& out)
+{
+    static const char *puncts[] = {
+        "+", "-", "*", "/", "%", "++", "--", "&&", "||", "!", "==", "!=",
+        "<", "<=", ">", ">=", "=", "+=", "-=", "*=", "/=", "%=", "<<=", ">>=",
+        "&=", "|=", "^=", "<<", ">>", "&", "|", "^", "~", "->", "?",
+        ",", ".", ":", ";", "(", ")", "[", "]", "{", "}",
+    };
+
+    for (int i = 0; i < 16; i++)
+    {
+        out += puncts[r.Below(sizeof(puncts) / sizeof(puncts[0]))];
+        out += ' ';
+    }
+    out += '\n';
+}
+
+// deeply nested blocks and parenthesized expressions
+void GenNested(Rand& r, std::string& out)
+{
+    uint32_t depth = 32 + r.Below(96);
+
+    for (uint32_t i = 0; i < depth; i++)
+    {
+        out += "{ if (";
+    }
+    out += "a";
+    for (uint32_t i = 0; i < depth; i++)
+    {
+        out += ") b[i] = (c + ";
+        out += std::to_string(i);
+        out += "); }";
+    }
+    out += '\n';
+}
+
+struct Generator
+{
+    const char *name;
+    std::function<void(Rand&, std::string&)> gen;
+};
+
+std::string Generate(const Generator& g, size_t bytes)
+{
+    Rand r;
+    std::string out;
+
+    out.reserve(bytes + 4096);
+    while (out.size() < bytes)
+    {
+        g.gen(r, out);
+    }
+
+    return out;
+}
+
+void Usage()
+{
+    fprintf(stderr, "usage: c--bench [-s MB[,MB...]] [-n iterations] [-f filter]\n");
+    exit(1);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<double> sizes {1, 10};
+    int iterations {3};
+    std::string filter;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+            sizes.clear();
+            for (char *p = strtok(argv[++i], ","); p; p = strtok(nullptr, ","))
+            {
+                sizes.push_back(atof(p));
+            }
+        } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+            filter = argv[++i];
+        } else {
+            Usage();
+        }
+    }
+
+    if (sizes.empty() || iterations < 1) {
+        Usage();
+    }
+
+    std::vector<Generator> generators {
+        {"identifiers", GenIdents},
+        {"literals", GenLiterals},
+        {"punctuation", GenPuncts},
+        {"nested", GenNested},
+    };
+
+    c89::CcArg arg;
+
+    printf("%-12s %8s %10s %12s %12s\n", "input", "MB", "MB/s", "Mtokens/s", "allocs/tok");
+
+    for (auto& g : generators)
+    {
+        if (!filter.empty() && filter != g.name) {
+            continue;
+        }
+
+        for (double mb : sizes)
+        {
+            std::string src = Generate(g, (size_t)(mb * 1024 * 1024));
+            double best {1e30};
+            size_t ntokens {0};
+            uint64_t allocs {0};
+
+            for (int it = 0; it < iterations; it++)
+            {
+                c89::Tokenizer toks;
+                uint64_t a0 = heapallocs;
+                uint64_t t0 = c89::Profiler::Now();
+
+                toks.Tokenize(arg, "<bench>", src);
+
+                uint64_t t1 = c89::Profiler::Now();
+                double secs = (t1 - t0) / 1e9;
+
+                if (secs < best) {
+                    best = secs;
+                }
+                ntokens = toks.tokenlist.size();
+                allocs = heapallocs - a0;
+            }
+
+            double size = src.size() / (1024.0 * 1024.0);
+            printf("%-12s %8.1f %10.2f %12.2f %12.2f\n", g.name, size, size / best,
+                   ntokens / best / 1e6, ntokens ? (double)allocs / ntokens : 0.0);
+            fflush(stdout);
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * allocs/tok counts heap allocations, the replacement lives here so that
+ * only the benchmark pays for it
+ */
+void* operator new(size_t size)
+{
+    heapallocs.fetch_add(1, std::memory_order_relaxed);
+
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+    free(p);
+}
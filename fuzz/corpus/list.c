@@ -0,0 +1,66 @@
+struct node {
+    struct node *next;
+    struct node *prev;
+    void *data;
+};
+
+struct list {
+    struct node head;
+    unsigned long length;
+};
+
+extern void *malloc(unsigned long size);
+extern void free(void *ptr);
+
+void list_init(struct list *l)
+{
+    l->head.next = &l->head;
+    l->head.prev = &l->head;
+    l->length = 0UL;
+}
+
+int list_push(struct list *l, void *data)
+{
+    struct node *n = (struct node *)malloc(sizeof(*n));
+
+    if (n == (struct node *)0) {
+        return -1;
+    }
+
+    n->data = data;
+    n->next = &l->head;
+    n->prev = l->head.prev;
+    l->head.prev->next = n;
+    l->head.prev = n;
+    ++l->length;
+
+    return 0;
+}
+
+void *list_pop(struct list *l)
+{
+    struct node *n = l->head.prev;
+    void *data;
+
+    if (n == &l->head) {
+        return 0;
+    }
+
+    n->prev->next = n->next;
+    n->next->prev = n->prev;
+    data = n->data;
+    free(n);
+    l->length--;
+
+    return data;
+}
+
+void list_each(struct list *l, void (*fn)(void *, void *), void *arg)
+{
+    struct node *n, *next;
+
+    for (n = l->head.next; n != &l->head; n = next) {
+        next = n->next;
+        fn(n->data, arg);
+    }
+}
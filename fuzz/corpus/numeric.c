@@ -0,0 +1,62 @@
+typedef unsigned int uint32;
+typedef unsigned long long uint64;
+
+static const double coeffs[] = { 1.0, .5, 0.166666666666666667, 4.16666666666666667e-2, 8.333e-3F };
+static const long double pi = 3.14159265358979323846264338327950288L;
+static const float eps = 1.19209290E-07f;
+
+uint32 rotl(uint32 x, int k)
+{
+    return (x << k) | (x >> (32 - k));
+}
+
+uint64 mix(uint64 z)
+{
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+double exp_approx(double x)
+{
+    double sum = 0.0, term = 1.0;
+    int i;
+
+    for (i = 0; i < 5; i++) {
+        sum += coeffs[i] * term;
+        term *= x;
+    }
+
+    return sum;
+}
+
+long clamp(long v, long lo, long hi)
+{
+    return v < lo ? lo : v > hi ? hi : v;
+}
+
+int flags(unsigned f)
+{
+    int n = 0;
+
+    n += (f & 01) != 0;
+    n += (f & 0x2u) != 0;
+    n += (f & 4U) != 0;
+    n += (f & 010L) != 0;
+    f >>= 4;
+    f <<= 1;
+    f |= 1;
+    f &= ~0u;
+    f ^= 0XFFlu;
+    f %= 7;
+    f /= 2;
+    f -= 1;
+
+    return n + (int)f + !f + -n;
+}
+
+int main(void)
+{
+    double y = exp_approx(1e-3) * 2.5e+2 / 1E2;
+    return (int)y + (int)(pi * eps) + flags(0xffu) + (int)clamp(-40000L, -32768L, 32767L);
+}
@@ -0,0 +1,64 @@
+extern int printf(const char *fmt, ...);
+
+static const char hexdigits[] = "0123456789abcdef";
+static const char *names[] = { "alpha", "beta\tgamma", "quote \" and \\ backslash", "" };
+
+unsigned long hash(const char *s)
+{
+    unsigned long h = 5381UL;
+    int c;
+
+    while ((c = *s++) != '\0')
+        h = ((h << 5) + h) ^ (unsigned char)c;
+
+    return h & 0xffffffffUL;
+}
+
+int to_hex(char *out, const unsigned char *in, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        out[2 * i] = hexdigits[in[i] >> 4];
+        out[2 * i + 1] = hexdigits[in[i] & 017];
+    }
+    out[2 * n] = '\0';
+
+    return 2 * n;
+}
+
+int escape(char *out, const char *in)
+{
+    char *p = out;
+
+    for (; *in; in++) {
+        switch (*in) {
+        case '\n': *p++ = '\\'; *p++ = 'n'; break;
+        case '\t': *p++ = '\\'; *p++ = 't'; break;
+        case '\'': *p++ = '\\'; *p++ = '\''; break;
+        case '"':  *p++ = '\\'; *p++ = '"'; break;
+        case '\\': *p++ = '\\'; *p++ = '\\'; break;
+        case '\a': case '\b': case '\f': case '\v': case '\r':
+            *p++ = '?';
+            break;
+        default:
+            *p++ = *in >= ' ' && *in <= '~' ? *in : '\x3f';
+        }
+    }
+    *p = '\0';
+
+    return (int)(p - out);
+}
+
+int main(int argc, char **argv)
+{
+    char buf[256];
+    int i;
+
+    for (i = 0; i < (int)(sizeof(names) / sizeof(names[0])); i++) {
+        escape(buf, names[i]);
+        printf("%-12s %08lx\n", buf, hash(names[i]));
+    }
+
+    return argc > 1 && argv[1][0] == '-' ? 1 : 0;
+}
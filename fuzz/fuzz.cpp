@@ -0,0 +1,551 @@
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "profile.h"
+#include "argument.h"
+#include "tokenize.h"
+
+/*
+ * c--fuzz: Tokenizer::Tokenize under a fuzzer, checked against a small
+ * reference lexer.
+ *
+ * Built with clang, this is a libFuzzer target (run it as libFuzzer
+ * does). Otherwise it has its own driver:
+ *
+ *   c--fuzz [-n iterations] [-s seed] [corpus file or dir ...]
+ *
+ * which lexes every corpus file, then mutates them (or built-in seeds)
+ * for n iterations and reports execs/sec. A failing input is written
+ * to crash.c before aborting. fuzz/corpus holds seed sources, already
+ * preprocessed, for either driver.
+ *
+ * The reference lexer follows the C89 lexical grammar (3.1), not the
+ * tokenizer's code, and only decides kinds and extents. Where the
+ * tokenizer deliberately differs from the standard it follows the
+ * tokenizer: LL suffixes are accepted, integer constants must fit in
+ * 64 bits, multi-character constants are rejected, and there are no
+ * line splices or # tokens, as the preprocessor has run already.
+ * Inputs with diagnostics are checked for sane token extents only.
+ */
+
+namespace {
+
+struct RefToken
+{
+    c89::TokenType type;
+    size_t offset;
+    size_t length;
+};
+
+struct Punct
+{
+    const char *spelling;
+    c89::TokenType type;
+};
+
+// 3.1.5 operators and 3.1.6 punctuators, longest first
+const Punct puncts[] = {
+    {"<<=", c89::TK_OPEOR}, {">>=", c89::TK_OPEOR}, {"...", c89::TK_SEPOR},
+    {"->", c89::TK_OPEOR}, {"++", c89::TK_OPEOR}, {"--", c89::TK_OPEOR}, {"<<", c89::TK_OPEOR},
+    {">>", c89::TK_OPEOR}, {"<=", c89::TK_OPEOR}, {">=", c89::TK_OPEOR}, {"==", c89::TK_OPEOR},
+    {"!=", c89::TK_OPEOR}, {"&&", c89::TK_OPEOR}, {"||", c89::TK_OPEOR}, {"*=", c89::TK_OPEOR},
+    {"/=", c89::TK_OPEOR}, {"%=", c89::TK_OPEOR}, {"+=", c89::TK_OPEOR}, {"-=", c89::TK_OPEOR},
+    {"&=", c89::TK_OPEOR}, {"^=", c89::TK_OPEOR}, {"|=", c89::TK_OPEOR},
+    {"[", c89::TK_SEPOR}, {"]", c89::TK_SEPOR}, {"(", c89::TK_SEPOR}, {")", c89::TK_SEPOR},
+    {"{", c89::TK_SEPOR}, {"}", c89::TK_SEPOR}, {".", c89::TK_SEPOR}, {",", c89::TK_SEPOR},
+    {":", c89::TK_SEPOR}, {";", c89::TK_SEPOR},
+    {"&", c89::TK_OPEOR}, {"*", c89::TK_OPEOR}, {"+", c89::TK_OPEOR}, {"-", c89::TK_OPEOR},
+    {"~", c89::TK_OPEOR}, {"!", c89::TK_OPEOR}, {"/", c89::TK_OPEOR}, {"%", c89::TK_OPEOR},
+    {"<", c89::TK_OPEOR}, {">", c89::TK_OPEOR}, {"^", c89::TK_OPEOR}, {"|", c89::TK_OPEOR},
+    {"?", c89::TK_OPEOR}, {"=", c89::TK_OPEOR},
+};
+
+// the source character set, not the locale's
+bool IsSpace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\v' || ch == '\f' || ch == '\r';
+}
+
+bool IsDigit(char ch)
+{
+    return ch >= '0' && ch <= '9';
+}
+
+bool IsNondigit(char ch)
+{
+    return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || ch == '_';
+}
+
+int DigitValue(char ch)
+{
+    if (IsDigit(ch)) {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return 99;
+}
+
+// 3.1.3.2 integer-suffix, plus ll in one case
+bool IntSuffix(const std::string& suffix)
+{
+    static const char *valid[] = {
+        "", "u", "U", "l", "L", "ul", "uL", "Ul", "UL", "lu", "lU", "Lu", "LU",
+        "ll", "LL", "ull", "uLL", "Ull", "ULL", "llu", "llU", "LLu", "LLU",
+    };
+
+    for (const char *v : valid)
+    {
+        if (suffix == v) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// 3.1.3.2 decimal, octal or hexadecimal constant with its suffix
+bool IntConstant(const std::string& s)
+{
+    size_t i = 0;
+    uint64_t base = 10, value = 0;
+
+    if (s.size() > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X') && DigitValue(s[2]) < 16) {
+        base = 16;
+        i = 2;
+    } else if (s[0] == '0') {
+        base = 8;
+    }
+
+    for (; i < s.size() && DigitValue(s[i]) < (int)base; i++)
+    {
+        uint64_t digit = DigitValue(s[i]);
+        if (value > (UINT64_MAX - digit) / base) {
+            return false;
+        }
+        value = value * base + digit;
+    }
+
+    return IntSuffix(s.substr(i));
+}
+
+/*
+ * 3.1.3.1 floating-constant: a fractional-constant with an optional
+ * exponent-part, or a digit-sequence with one, then f, F, l or L
+ */
+bool FloatConstant(const std::string& s)
+{
+    size_t i = 0, digits = 0;
+    bool fraction = false;
+
+    for (; i < s.size() && IsDigit(s[i]); i++)
+    {
+        digits++;
+    }
+    if (i < s.size() && s[i] == '.') {
+        fraction = true;
+        for (i++; i < s.size() && IsDigit(s[i]); i++)
+        {
+            digits++;
+        }
+    }
+    if (!digits) {
+        return false;
+    }
+
+    bool exponent = i < s.size() && (s[i] == 'e' || s[i] == 'E');
+    if (exponent) {
+        i++;
+        if (i < s.size() && (s[i] == '+' || s[i] == '-')) {
+            i++;
+        }
+        if (i == s.size() || !IsDigit(s[i])) {
+            return false;
+        }
+        while (i < s.size() && IsDigit(s[i]))
+        {
+            i++;
+        }
+    }
+
+    if (!fraction && !exponent) {
+        return false;
+    }
+
+    std::string suffix = s.substr(i);
+    return suffix.empty() || suffix == "f" || suffix == "F" || suffix == "l" || suffix == "L";
+}
+
+/*
+ * 3.1.3.4 escape-sequence at s[i], on the backslash. i is left after it.
+ * Octal and hexadecimal values must fit in an unsigned char.
+ */
+bool Escape(const char *s, size_t& i)
+{
+    int value = 0, n = 0;
+
+    i++;
+    if (s[i] && strchr("'\"?\\abfnrtv", s[i])) {
+        i++;
+        return true;
+    }
+
+    if (s[i] >= '0' && s[i] <= '7') {
+        for (; n < 3 && s[i] >= '0' && s[i] <= '7'; n++, i++)
+        {
+            value = value * 8 + s[i] - '0';
+        }
+        return value <= 255;
+    }
+
+    if (s[i] == 'x') {
+        for (i++; DigitValue(s[i]) < 16; n++, i++)
+        {
+            value = std::min(value * 16 + DigitValue(s[i]), 256);
+        }
+        return n > 0 && value <= 255;
+    }
+
+    return false;
+}
+
+// false where the tokenizer must report a diagnostic
+bool RefLex(const char *s, std::vector<RefToken>& out)
+{
+    size_t i = 0;
+
+    while (s[i])
+    {
+        size_t start = i;
+
+        if (IsSpace(s[i])) {
+            i++;
+            continue;
+        }
+
+        // 3.1.2 identifier
+        if (IsNondigit(s[i])) {
+            while (IsNondigit(s[i]) || IsDigit(s[i]))
+            {
+                i++;
+            }
+            out.push_back(RefToken{c89::TK_IDENT, start, i - start});
+            continue;
+        }
+
+        // 3.1.8 pp-number, which must then be a 3.1.3 constant
+        if (IsDigit(s[i]) || (s[i] == '.' && IsDigit(s[i+1]))) {
+            for (i++; s[i]; i++)
+            {
+                if ((s[i] == 'e' || s[i] == 'E') && (s[i+1] == '+' || s[i+1] == '-')) {
+                    i++;
+                } else if (!IsNondigit(s[i]) && !IsDigit(s[i]) && s[i] != '.') {
+                    break;
+                }
+            }
+
+            std::string number(s + start, i - start);
+            if (!IntConstant(number) && !FloatConstant(number)) {
+                return false;
+            }
+            out.push_back(RefToken{c89::TK_NUM, start, i - start});
+            continue;
+        }
+
+        // 3.1.3.4 character-constant, exactly one c-char
+        if (s[i] == '\'') {
+            i++;
+            if (s[i] == '\\') {
+                if (!Escape(s, i)) {
+                    return false;
+                }
+            } else if (s[i] && s[i] != '\'' && s[i] != '\n') {
+                i++;
+            } else {
+                return false;
+            }
+
+            if (s[i] != '\'') {
+                return false;
+            }
+            i++;
+            out.push_back(RefToken{c89::TK_CHAR, start, i - start});
+            continue;
+        }
+
+        // 3.1.4 string-literal
+        if (s[i] == '"') {
+            for (i++; s[i] && s[i] != '"' && s[i] != '\n';)
+            {
+                if (s[i] == '\\') {
+                    if (!Escape(s, i)) {
+                        return false;
+                    }
+                } else {
+                    i++;
+                }
+            }
+
+            if (s[i] != '"') {
+                return false;
+            }
+            i++;
+            out.push_back(RefToken{c89::TK_STR, start, i - start});
+            continue;
+        }
+
+        const Punct *match = nullptr;
+        for (const Punct& p : puncts)
+        {
+            if (!strncmp(s + i, p.spelling, strlen(p.spelling))) {
+                match = &p;
+                break;
+            }
+        }
+        if (!match) {
+            return false;
+        }
+
+        i += strlen(match->spelling);
+        out.push_back(RefToken{match->type, start, i - start});
+    }
+
+    return true;
+}
+
+void Fail(const std::string& input, const char *what, size_t index)
+{
+    FILE *fp = fopen("crash.c", "wb");
+    if (fp) {
+        fwrite(input.data(), 1, input.size(), fp);
+        fclose(fp);
+    }
+
+    fprintf(stderr, "c--fuzz: %s at token %zu, input written to crash.c\n", what, index);
+    abort();
+}
+
+void CheckOne(const std::string& input)
+{
+    c89::CcArg arg;
+    c89::Tokenizer toks;
+    std::vector<RefToken> ref;
+
+    toks.Tokenize(arg, "<fuzz>", input);
+
+    // extents must be in order and inside the text the lexer saw
+    size_t end = strlen(input.c_str()), last = 0, i = 0;
+    for (auto& t : toks.tokenlist)
+    {
+        if (t->offset < last || t->length == 0 || t->offset + t->length > end) {
+            Fail(input, "bad token extent", i);
+        }
+        last = t->offset + t->length;
+        i++;
+    }
+
+    bool clean = RefLex(input.c_str(), ref);
+    if (clean != (toks.diags.Count() == 0)) {
+        Fail(input, clean ? "unexpected diagnostic" : "missing diagnostic", 0);
+    }
+    if (!clean) {
+        return;
+    }
+
+    if (ref.size() != toks.tokenlist.size()) {
+        Fail(input, "token count differs from the reference lexer", std::min(ref.size(), toks.tokenlist.size()));
+    }
+
+    i = 0;
+    for (auto& t : toks.tokenlist)
+    {
+        const RefToken& r = ref[i];
+        if (t->type != r.type || t->offset != r.offset || t->length != r.length) {
+            Fail(input, "token differs from the reference lexer", i);
+        }
+        i++;
+    }
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    CheckOne(std::string((const char *)data, size));
+    return 0;
+}
+
+#ifndef C89_LIBFUZZER
+
+namespace {
+
+// same generator as c--bench, inputs are reproducible from the seed
+class Rand
+{
+public:
+    explicit Rand(uint64_t seed) : m_state(seed * 0x9E3779B97F4A7C15ULL + 1) {}
+
+    uint32_t Next()
+    {
+        m_state = m_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        return m_state >> 33;
+    }
+
+    uint32_t Below(uint32_t n) { return Next() % n; }
+
+private:
+    uint64_t m_state;
+};
+
+// spellings around the tokenizer's corner cases
+const char *dictionary[] = {
+    "\"\\\\\"", "\"\\\"\"", "\"", "'", "'\\''", "'\\\\'", "'\\x'", "'\\xfF'", "'\\0'",
+    "'\\777'", "'\\1234'", "'\\q'", "''", "'ab'", "0x", "0X1f", "0777", "09", ".5", "1.",
+    "1e10", "1E", "0x1e", "1.5f", "1.5L", "1.5UL", "1U", "1u", "1L", "1ul", "1LU", "1ULL",
+    "1LLU", "1lul", "1LLL", "1lL", "1UU", "1F", "1e+5", "1e+", "08.5", "0x1e+1", "'\\400'",
+    "'\\x100'", "18446744073709551616", "<<=", ">>=", "->", "~=", "...", "..", "#", "@", "$",
+    "`", "\\", "int", "_x9", " ", "\n", "\t", "\x01", "\x7f", "\xff",
+};
+
+const char *seeds[] = {
+    "int main(void) { return 0; }\n",
+    "static char *s = \"a\\\"b\\\\\"; int c = '\\n' + '\\x41' + '\\101';\n",
+    "unsigned long x = 0x1fUL << 3; double d = 1.5e10 * .5f / 3.L;\n",
+    "for (i = 0; i < n; ++i) { a[i] -= b->c[i] ? p->q : ~r; x <<= 1; y >>= 2; }\n",
+};
+
+void Mutate(Rand& r, std::string& s)
+{
+    for (uint32_t n = 1 + r.Below(4); n > 0; n--)
+    {
+        size_t pos = s.empty() ? 0 : r.Below(s.size() + 1);
+
+        switch (r.Below(4))
+        {
+        case 0:
+            if (!s.empty() && pos < s.size()) {
+                s[pos] ^= 1 << r.Below(8);
+            }
+            break;
+        case 1:
+            s.insert(pos, 1, (char)r.Below(256));
+            break;
+        case 2:
+            if (!s.empty()) {
+                s.erase(r.Below(s.size()), 1 + r.Below(8));
+            }
+            break;
+        default:
+            s.insert(pos, dictionary[r.Below(sizeof(dictionary) / sizeof(dictionary[0]))]);
+            break;
+        }
+    }
+}
+
+void LoadCorpus(const std::string& path, std::vector<std::string>& corpus)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st)) {
+        fprintf(stderr, "c--fuzz: can not read %s\n", path.c_str());
+        exit(1);
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        DIR *dir = opendir(path.c_str());
+        struct dirent *ent;
+
+        while (dir && (ent = readdir(dir)))
+        {
+            if (ent->d_name[0] != '.') {
+                LoadCorpus(path + "/" + ent->d_name, corpus);
+            }
+        }
+        if (dir) {
+            closedir(dir);
+        }
+        return;
+    }
+
+    FILE *fp = fopen(path.c_str(), "rb");
+    if (!fp) {
+        return;
+    }
+
+    std::string s(st.st_size, '\0');
+    s.resize(fread(&s[0], 1, s.size(), fp));
+    fclose(fp);
+    corpus.push_back(s);
+}
+
+void Usage()
+{
+    fprintf(stderr, "usage: c--fuzz [-n iterations] [-s seed] [corpus file or dir ...]\n");
+    exit(1);
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    uint64_t iterations = 100000, seed = 1;
+    std::vector<std::string> corpus;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-n") && i+1 < argc) {
+            iterations = strtoull(argv[++i], nullptr, 10);
+        } else if (!strcmp(argv[i], "-s") && i+1 < argc) {
+            seed = strtoull(argv[++i], nullptr, 10);
+        } else if (argv[i][0] == '-') {
+            Usage();
+        } else {
+            LoadCorpus(argv[i], corpus);
+        }
+    }
+
+    size_t bytes = 0;
+    uint64_t execs = corpus.size() + iterations;
+    uint64_t start = c89::Profiler::Now();
+
+    // the corpus as is, then mutated
+    for (const auto& s : corpus)
+    {
+        CheckOne(s);
+        bytes += s.size();
+    }
+
+    if (corpus.empty()) {
+        corpus.assign(seeds, seeds + sizeof(seeds) / sizeof(seeds[0]));
+    }
+
+    Rand r(seed);
+    std::string input;
+    for (uint64_t n = 0; n < iterations; n++)
+    {
+        input = corpus[r.Below(corpus.size())];
+        Mutate(r, input);
+
+        CheckOne(input);
+        bytes += input.size();
+    }
+
+    double secs = (c89::Profiler::Now() - start) / 1e9;
+
+    printf("%llu execs in %.2f s: %.0f execs/s, %.2f MB/s\n", (unsigned long long)execs, secs,
+           secs > 0 ? execs / secs : 0.0, secs > 0 ? bytes / secs / 1e6 : 0.0);
+
+    return 0;
+}
+
+#endif
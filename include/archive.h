@@ -0,0 +1,78 @@
+#ifndef __ARCHIVE_H__
+#define __ARCHIVE_H__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "mappedfile.h"
+
+namespace c89 {
+
+/*
+ * Hash table over the "/" (or "/SYM64/") symbol index of a static archive.
+ * The table is stored in Files::CacheDir()/archives, keyed by the archive's
+ * inode, size and mtime, and used in place through mmap on later links.
+ *
+ *   Header
+ *   archive path
+ *   uint32_t buckets[nbuckets]   8-aligned, entry index + 1, 0 if empty
+ *   Entry[nentries]              8-aligned
+ *   string table                 at stroff
+ *
+ * Lookups probe linearly until an empty bucket; a table without one is
+ * rejected when it is mapped.
+ */
+class ArchiveIndex
+{
+public:
+    bool Load(const std::string& path, const MappedFile& ar);
+
+    // header offset of the first member defining name, npos if none
+    size_t Find(const std::string& name) const;
+
+    static const size_t npos = (size_t)-1;
+
+    struct Header
+    {
+        char magic[8];
+        uint64_t ino;
+        uint64_t size;
+        uint64_t mtime_sec;
+        uint64_t mtime_nsec;
+        uint32_t nbuckets;      // power of two
+        uint32_t nentries;
+        uint32_t pathlen;
+        uint32_t strsize;
+        uint64_t stroff;        // string table offset from the start
+    };
+
+    struct Entry
+    {
+        uint64_t member;        // member header offset in the archive
+        uint32_t name;          // offset in the string table
+        uint32_t len;
+    };
+
+private:
+    static uint32_t Hash(const char *str, size_t len);
+    static std::string CachePath(const std::string& path);
+
+    bool Build(const std::string& path, const MappedFile& ar);
+    bool Map(const uint8_t *data, size_t size);
+    void Save(const std::string& cachepath) const;
+
+private:
+    std::unique_ptr<MappedFile> cache;  // mapped cache file
+    std::vector<uint64_t> image;        // freshly built table, same layout
+
+    const Header *header = nullptr;
+    const uint32_t *buckets = nullptr;
+    const Entry *entries = nullptr;
+    const char *strings = nullptr;
+};
+
+}
+
+#endif
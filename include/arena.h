@@ -0,0 +1,110 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <list>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace c89 {
+
+/*
+ * Bump allocator over mmap'ed chunks. Nothing is freed individually,
+ * the destructor unmaps every chunk. Each new chunk is twice the size of the previous one, up to maxchunk:
+ * chunks are populated when mapped and bigger ones evict the cache before
+ * they are filled.
+ */
+class Arena
+{
+public:
+    static const size_t maxchunk = 1 << 20;
+
+    explicit Arena(size_t chunksize = 64 << 10) : m_chunksize(chunksize) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena();
+
+    void* Allocate(size_t size, size_t align = alignof(std::max_align_t))
+    {
+        char *p = (char *)(((uintptr_t)m_ptr + align - 1) & ~(uintptr_t)(align - 1));
+
+        // a large align can take p past the end of the chunk
+        if (!m_ptr || p > m_end || size > (size_t)(m_end - p)) {
+            p = Grow(size, align);
+        }
+
+        m_ptr = p + size;
+        m_allocs++;
+        return p;
+    }
+
+    // size of the first chunk, e.g. estimated from the input; ignored once one is mapped
+    void SizeHint(size_t bytes)
+    {
+        if (!m_chunks.empty()) {
+            return;
+        }
+
+        if (bytes < 4096) {
+            m_chunksize = 4096;
+        } else if (bytes > maxchunk) {
+            m_chunksize = maxchunk;
+        } else {
+            m_chunksize = bytes;
+        }
+    }
+
+private:
+    struct Chunk
+    {
+        char *base;
+        size_t size;
+    };
+
+    char* Grow(size_t size, size_t align);
+
+private:
+    size_t m_chunksize;
+    std::vector<Chunk> m_chunks;
+    char *m_ptr = nullptr;
+    char *m_end = nullptr;
+    size_t m_allocs = 0;
+};
+
+// std allocator on top of an Arena, deallocate() is a no-op
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(Arena& arena) : m_arena(&arena) {}
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.m_arena) {}
+
+    T* allocate(size_t n)
+    {
+        return (T *)m_arena->Allocate(n * sizeof(T), alignof(T));
+    }
+
+    void deallocate(T *, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return m_arena == other.m_arena; }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return m_arena != other.m_arena; }
+
+private:
+    template <typename U> friend class ArenaAllocator;
+
+    Arena *m_arena;
+};
+
+template <typename T>
+using ArenaList = std::list<T, ArenaAllocator<T>>;
+
+}
+
+#endif
@@ -19,6 +19,8 @@ public:
     CcArg();
     void ParseArgs(int argc, char **argv);
     Languages ParseOptx(const std::string& arg);
+    void ParseOptO(const std::string& arg);
+    void CheckLoopbackWorkers(const char *n);
     void ParseOptWl(const std::string& str, std::vector<std::string>& ldargs);
 
 public:
@@ -29,6 +31,25 @@ public:
     bool opt_fpic = false; // -fPIC
     bool opt_static = false; // -static
     bool opt_shared = false; // -shared
+    bool opt_nostdlib = false; // -nostdlib
+    bool opt_builtin_ld = false; // -fbuiltin-ld
+
+    bool opt_time_report = false; // -ftime-report
+    bool opt_dump_tokens = false; // -dump-tokens
+    bool opt_emit_tokens = false; // -emit-tokens
+    bool opt_worker = false; // --worker
+
+    // Optimization options
+    int opt_level = 0; // -O0 -O1 -O2 -O3, -O and -Og are -O1
+    bool opt_Os = false; // -Os and -Oz, also sets opt_level 2
+    unsigned int inline_limit = 600; // -finline-limit=, in pseudo instructions as gcc
+    bool opt_profile_generate = false; // -fprofile-generate[=path]
+    bool opt_profile_use = false; // -fprofile-use[=path]
+    std::string profilepath; // directory or file of the profile data
+    bool opt_flto = false; // -flto -fno-lto
+
+    // Target options, SSE2 is the x86-64 baseline
+    bool opt_mavx2 = false; // -mavx2 -mno-avx2
 
     // Warning Options
     bool opt_Wall = false; // -Wall
@@ -42,6 +63,10 @@ public:
     std::vector<std::string> input;
     std::vector<std::string> ldargs; // -l -Wl -L
     std::vector<std::string> includes; // -I
+    std::string tracefile; // -ftrace=
+    std::vector<std::string> workers; // -fworkers=
+    std::string workeraddr; // --worker
+    std::vector<std::string> workerallow; // --worker-allow, addr[/bits] of drivers
 };
 }
 
@@ -9,7 +9,11 @@ namespace c89 {
 class Assembler
 {
 public:
-    static void Assemble(const CcArg& arg, Files& files);
+    // assemble one .s file into obj, false if as could not be run or failed
+    static bool AssembleFile(const std::string& file, const std::string& obj);
+
+    // keep the objects of "-c", they are not linked
+    static void Finish(const CcArg& arg, Files& files);
 };
 
 }
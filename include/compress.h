@@ -0,0 +1,26 @@
+#ifndef __COMPRESS_H__
+#define __COMPRESS_H__
+
+#include <string>
+#include <cstddef>
+
+namespace c89 {
+
+/*
+ * LZ4 block format (no frame): greedy matching over a 64 KB window.
+ * Fast rather than small, made for assembly and object files on the
+ * wire between the driver and its workers.
+ */
+class Lz4
+{
+public:
+    // compress [src, src+len) into out, replacing its contents
+    static void Compress(const char *src, size_t len, std::string& out);
+
+    // false if the block is corrupt or does not expand to exactly rawsize
+    static bool Decompress(const char *src, size_t len, char *dst, size_t rawsize);
+};
+
+}
+
+#endif
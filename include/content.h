@@ -8,8 +8,8 @@ namespace c89 {
 class Content {
 public:
     Content(const std::string& filename, const std::string &content)
-        : m_row(1), m_column(0), m_filename(filename), m_content(content.c_str()),
-          line_start (content.c_str()) {}
+        : m_row(1), m_column(0), m_filename(filename), m_begin(content.c_str()),
+          m_content(content.c_str()), line_start (content.c_str()) {}
 
 public:
     /* c++ */
@@ -80,31 +80,13 @@ public:
     inline const std::string& Filename(void) {return m_filename;}
     inline unsigned int Row(void) {return m_row;}
     inline unsigned int Column(void) {return m_column;}
-    inline std::string Location(void) { return m_filename+":"+std::to_string(m_row)+":"+std::to_string(m_column) + " "; }
-    inline std::string Currline(void) 
-    {
-         return std::string("\n\t\t") + std::to_string(m_row) + " | " + 
-                std::string(line_start, FindNewLine(m_content)) + "\n";
-    }
-
-private:
-    const char *FindNewLine(const char *str)
-    {
-        for (; *str != '\0'; str++)
-        {
-            if (*str == '\n') {
-                return str;
-            }
-        }
-
-        return str;
-    }
-
+    inline size_t Offset(void) {return m_content - m_begin;}
 
 private:
     unsigned int m_row;
     unsigned int m_column;
     std::string m_filename;
+    const char *m_begin;
     const char *m_content;
     const char *line_start;
 };
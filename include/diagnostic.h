@@ -0,0 +1,60 @@
+#ifndef __DIAGNOSTIC_H__
+#define __DIAGNOSTIC_H__
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace c89 {
+
+enum DiagCode
+{
+    D_UNRECOGNIZED_CHAR,
+    D_UNTERMINATED_STRING,
+    D_INT_SUFFIX,
+    D_FLOAT_SUFFIX,
+    D_SUFFIX,
+    D_EMPTY_CHAR,
+    D_MULTI_CHAR,
+    D_UNKNOWN_ESCAPE,
+    D_NO_HEX_DIGITS,
+    D_UNKNOWN_PUNCT,
+    D_UNTERMINATED_CHAR,
+    D_ESCAPE_RANGE,
+    D_OCTAL_DIGIT,
+    D_INT_RANGE,
+    D_EXPONENT,
+};
+
+// a diagnostic is formatted only when it is reported
+struct Diagnostic
+{
+    uint32_t offset;    // byte offset in the source
+    uint16_t code;      // DiagCode
+    char arg;           // offending character, for messages that show one
+};
+
+/*
+ * Diagnostics of one translation unit. Errors are recorded as they are
+ * found and compilation goes on, Report() formats all of them and writes
+ * them to stderr at once.
+ */
+class Diagnostics
+{
+public:
+    void Error(DiagCode code, size_t offset, char arg = 0)
+    {
+        m_diags.push_back(Diagnostic{(uint32_t)offset, (uint16_t)code, arg});
+    }
+
+    size_t Count() const { return m_diags.size(); }
+
+    void Report(const std::string& file, const std::string& content);
+
+private:
+    std::vector<Diagnostic> m_diags;
+};
+
+}
+
+#endif
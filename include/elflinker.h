@@ -0,0 +1,184 @@
+#ifndef __ELFLINKER_H__
+#define __ELFLINKER_H__
+
+#include <elf.h>
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "archive.h"
+#include "mappedfile.h"
+
+namespace c89 {
+
+struct ElfObject;
+struct OutputSection;
+
+struct ElfSymbol
+{
+    std::string name;
+    ElfObject *file = nullptr;    // defining object, null if undefined or synthetic
+    uint32_t shndx = SHN_UNDEF;
+    uint64_t value = 0;           // st_value, alignment for SHN_COMMON
+    uint64_t size = 0;
+    uint8_t bind = STB_LOCAL;
+    uint8_t type = STT_NOTYPE;
+    bool synthetic = false;       // defined by the linker (_end, __bss_start ...)
+    int64_t got = -1;             // GOT slot, -1 if none
+    uint64_t addr = 0;            // final virtual address
+};
+
+struct InputSection
+{
+    ElfObject *file = nullptr;
+    const Elf64_Shdr *shdr = nullptr;
+    std::string name;
+    const Elf64_Rela *relas = nullptr;
+    size_t nrelas = 0;
+    OutputSection *out = nullptr;
+    uint64_t offset = 0;          // offset in output section
+};
+
+struct ElfObject
+{
+    std::string name;
+    uint32_t priority = 0;        // command line order, breaks resolution ties
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    const Elf64_Shdr *shdrs = nullptr;
+    const Elf64_Sym *syms = nullptr;
+    size_t nsyms = 0;
+    const char *strtab = nullptr;
+    size_t strsize = 0;
+    uint32_t first_global = 0;
+    std::vector<std::unique_ptr<InputSection>> sections;  // by index, null if dropped
+    std::vector<ElfSymbol> locals;                        // symtab index < first_global
+    std::vector<ElfSymbol*> symbols;                      // symtab index -> symbol
+    std::vector<uint64_t> storage;                        // aligned copy of unaligned archive members
+};
+
+struct OutputSection
+{
+    std::string name;
+    uint32_t type = SHT_PROGBITS;
+    uint64_t flags = 0;
+    uint64_t align = 1;
+    uint64_t size = 0;
+    uint64_t addr = 0;
+    uint64_t offset = 0;          // file offset
+    uint32_t index = 0;           // section header index
+    std::vector<InputSection*> members;
+};
+
+// static archive (.a), members are extracted only when they resolve a symbol
+struct ElfArchive
+{
+    std::string name;
+    const MappedFile *file = nullptr;
+    ArchiveIndex index;
+    std::unordered_set<size_t> loaded;               // members already extracted
+};
+
+// global symbol table, sharded so objects can be resolved concurrently
+class SymbolMap
+{
+public:
+    // find or create name, returns with the owning shard locked
+    ElfSymbol* Insert(const std::string& name, std::unique_lock<std::mutex>& lock);
+    ElfSymbol* Find(const std::string& name);
+
+    template <typename Fn>
+    void ForEach(Fn fn)
+    {
+        for (auto& shard : shards)
+        {
+            for (auto& sym : shard.symbols)
+            {
+                fn(sym);
+            }
+        }
+    }
+
+private:
+    struct Shard
+    {
+        std::mutex lock;
+        std::unordered_map<std::string, ElfSymbol*> map;
+        std::deque<ElfSymbol> symbols;
+    };
+
+    Shard shards[64];
+};
+
+/*
+ * In-process static linker for x86-64 ELF relocatable objects and static
+ * archives. It only handles what a plain static executable needs; Link()
+ * returns false without touching the output when an input needs anything
+ * else (shared objects, TLS, IFUNC, COMDAT groups, unknown relocations,
+ * unresolved symbols ...), and the caller should fall back to ld. Malformed
+ * inputs are rejected the same way, and why then says what was wrong.
+ */
+class ElfLinker
+{
+public:
+    static bool Link(const std::string& output, const std::vector<std::string>& inputs,
+                     std::string *why = nullptr);
+
+private:
+    bool Run(const std::string& output, const std::vector<std::string>& inputs);
+    bool Reject(const std::string& reason);
+
+    bool AddFiles(const std::vector<std::string>& paths);
+    std::unique_ptr<ElfObject> NewObject(const std::string& name, const uint8_t *data,
+                                         size_t size, uint32_t priority);
+    bool ParseObject(ElfObject& obj);
+    bool CheckSymbol(ElfObject& obj, const Elf64_Sym& sym, uint32_t index);
+    bool ResolveSymbols(ElfObject& obj);
+    bool ResolveObjects(size_t from);
+    bool ResolveArchives();
+    void Layout();
+    bool DefineSynthetic();
+    bool ScanRelocations();
+    void AssignAddresses();
+    void BuildSymbolTable();
+    bool ApplyRelocations(InputSection& isec, uint8_t *image);
+    bool Write(const std::string& output);
+
+    OutputSection* GetOutputSection(const InputSection& isec);
+    ElfSymbol* Symbol(ElfObject& obj, uint32_t index);
+
+private:
+    std::vector<std::unique_ptr<MappedFile>> mapped;
+    std::vector<std::unique_ptr<ElfArchive>> archives;
+    std::vector<std::unique_ptr<ElfObject>> objects;
+    SymbolMap symtab;
+    uint32_t nextpriority = 0;
+    std::vector<std::unique_ptr<OutputSection>> outsecs;
+    std::vector<ElfSymbol*> commons;
+    std::vector<ElfSymbol*> gotsyms;
+    OutputSection *bss = nullptr;
+    OutputSection *got = nullptr;
+    std::mutex errlock;
+    std::string error;                // first reason a link was rejected
+
+    // file layout
+    std::vector<Elf64_Phdr> phdrs;
+    uint64_t filesize = 0;
+    uint64_t stroff = 0;
+    uint64_t symoff = 0;
+    uint64_t symstroff = 0;
+    uint64_t shoff = 0;
+    std::string shstrtab;
+    std::vector<Elf64_Sym> outsyms;   // .symtab, locals first
+    uint32_t nlocals = 0;
+    std::string symstrtab;            // .strtab
+};
+
+}
+
+#endif
@@ -16,6 +16,7 @@ enum FileType
     AR_FILE,
     DSO_FILE,
     PREC_FILE,
+    TOK_FILE,
     NONE_FILE,
 };
 
@@ -24,15 +25,19 @@ class Files
 public:
     static std::string DirName(const std::string& name);
     static std::string BaseName(const std::string& name);
+    static bool ReadFile(const std::string& name, std::string& content);
+    static bool WriteFile(const std::string& name, const std::string& content);
     static void RenameFile(const std::string& oldpath, const std::string& newpath);
     static FileType GetFileType(const std::string& name);
     static std::string ConvertTo(const std::string& name, FileType type);
+    static std::string CacheDir();
 
     void DispatchFiles(const CcArg& ccarg);
 
 public:
     std::vector<std::string> cfiles;    // input c file (.c)
     std::vector<std::string> tmpcfiles; // generated c file (xxx.i)
+    std::vector<std::string> tokfiles;  // lexed c file (.tok)
     std::vector<std::string> asmfiles;     // input asm file
     std::vector<std::string> tmpasmfiles;  // generated asm file
     std::vector<std::string> objfiles;     // input obj file (.o, .so, .a)
@@ -2,6 +2,7 @@
 #define __LINKER_H__
 
 #include <string>
+#include <vector>
 
 #include "files.h"
 #include "argument.h"
@@ -13,13 +14,10 @@ class Linker
 public:
     static void Link(const CcArg& arg, Files& files);
 
-    // crt1.o, crti.o, crtn.o
-    static std::string FindGlibCrt();
-
-    // crtbegin.o  crtend.o
-    static std::string FindGccLibCrt();
-
-    static unsigned int GetGccVersion();
+private:
+    static bool LinkBuiltin(const CcArg& arg, const Files& files);
+    static std::string FindLibrary(const std::string& name,
+                                   const std::vector<std::string>& dirs, bool isstatic);
 };
 
 }
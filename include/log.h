@@ -15,6 +15,12 @@ public:
         exit(1);
     }
 
+    // like Fatal, but the caller decides when to stop
+    static void Report(const std::string& str)
+    {
+        std::cerr << "\e[1;31merror: \e[0m" << str << std::endl;
+    }
+
     static void Warning(const std::string& str) 
     {
         std::cerr << "warning: " << str << std::endl;
@@ -0,0 +1,30 @@
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+#include <string>
+#include <cstdint>
+
+#include <sys/stat.h>
+
+namespace c89 {
+
+// read-only mmap of a whole file
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool Open(const std::string& path);
+
+public:
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    struct stat st;
+};
+
+}
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <cstddef>
+#include <functional>
+
+namespace c89 {
+
+class Parallel
+{
+public:
+    // worker threads used by For(), hardware concurrency by default
+    static unsigned int Threads();
+
+    // use n worker threads from now on, 0 goes back to the default
+    static void SetThreads(unsigned int n);
+
+    // run fn(i) for every i in [0, n) and wait for all of them
+    static void For(size_t n, const std::function<void(size_t)>& fn);
+};
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef __PIPELINE_H__
+#define __PIPELINE_H__
+
+#include <set>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include <condition_variable>
+
+namespace c89 {
+
+/*
+ * Items (translation units) flow through a sequence of stages. Different
+ * items occupy different stages at the same time on a work-stealing pool:
+ * every worker runs its own tasks newest first, so an item usually stays
+ * on one thread from stage to stage, and idle workers steal the oldest
+ * tasks of the others. At most Capacity() items are in flight at once,
+ * which bounds the memory held between stages.
+ *
+ * A serial stage runs one item at a time in item order; use it for
+ * anything whose output order matters (object files, dumps).
+ */
+class Pipeline
+{
+public:
+    typedef std::function<void(size_t)> Stage;
+
+    void AddStage(const char *name, const Stage& fn);
+    void AddSerialStage(const char *name, const Stage& fn);
+
+    // run items [0, n) through every stage, returns when all are done
+    void Run(size_t n);
+
+    static size_t Capacity();
+
+private:
+    struct StageInfo
+    {
+        const char *name;
+        Stage fn;
+        bool serial;
+
+        // serial stages only
+        std::mutex lock;
+        std::set<size_t> ready;
+        size_t next = 0;
+        bool busy = false;
+    };
+
+    struct Task
+    {
+        size_t item;
+        size_t stage;
+    };
+
+    struct Worker
+    {
+        std::mutex lock;
+        std::deque<Task> tasks;
+    };
+
+    void Loop(size_t self);
+    bool Take(size_t self, Task& task);
+    void Push(size_t self, const Task& task);
+    void Forward(size_t self, size_t item, size_t stage);
+    void Drain(size_t self, size_t index, size_t item);
+    void Execute(StageInfo& stage, size_t item);
+
+private:
+    std::deque<StageInfo> stages;
+    std::deque<Worker> workers;
+
+    size_t nitems = 0;
+    std::atomic<size_t> admitted {0};
+    std::atomic<size_t> finished {0};
+    std::atomic<size_t> queued {0};
+
+    // idle workers sleep here
+    std::mutex idlelock;
+    std::condition_variable idle;
+};
+
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef __PROCESS_H__
+#define __PROCESS_H__
+
+#include <string>
+#include <cstdint>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace c89 {
+
+/*
+ * Child processes are started with posix_spawnp(), which glibc implements
+ * with clone(CLONE_VM|CLONE_VFORK): no page tables are copied, whatever
+ * the size of our heap.
+ */
+class Process
+{
+public:
+    // argv must end with nullptr; if stdinfd is given, the child reads
+    // its stdin from a pipe whose write end is returned there. quiet
+    // sends the child's stderr to /dev/null.
+    // -1 if the pipe or the process can not be created, errno is set
+    static pid_t Spawn(const std::vector<const char*>& argv, int *stdinfd = nullptr,
+                       bool quiet = false);
+
+    // exit status of pid, -1 if it did not exit normally
+    static int Wait(pid_t pid);
+
+    // Spawn + Wait, -1 if argv[0] could not be run
+    static int Run(const std::vector<const char*>& argv);
+};
+
+/*
+ * Assembly text written here is piped to "as -o <obj> -" as it is
+ * produced, so assembling overlaps with codegen and no .s file is written.
+ */
+class AsmPipe
+{
+public:
+    AsmPipe() = default;
+    AsmPipe(const AsmPipe&) = delete;
+    AsmPipe& operator=(const AsmPipe&) = delete;
+    ~AsmPipe();
+
+    // false if as can not be started, Close() then fails too;
+    // quiet drops the diagnostics of as
+    bool Open(const std::string& objfile, bool quiet = false);
+    void Write(const char *data, size_t len);
+    void Write(const std::string& str) { Write(str.data(), str.size()); }
+
+    // flush, close the pipe and wait for as, false if as failed or
+    // stopped reading before the end of the text
+    bool Close();
+
+private:
+    void Flush();
+
+private:
+    pid_t m_pid = -1;
+    int m_fd = -1;
+    bool m_failed = false;
+    uint64_t m_start = 0;
+    std::string m_buf;
+};
+
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef __PROFILE_H__
+#define __PROFILE_H__
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+namespace c89 {
+
+/*
+ * Phase timers and counters behind -ftime-report and -ftrace=<file>.
+ * Nothing is recorded until Enable() is called, the report and the
+ * Chrome trace-event file are written at exit.
+ */
+class Profiler
+{
+public:
+    static void Enable(bool report, const std::string& tracefile);
+    static bool Enabled() { return enabled; }
+
+    static uint64_t Now();  // monotonic nanoseconds
+    static void Record(const char *name, uint64_t start, uint64_t end);
+
+    // counters
+    static std::atomic<uint64_t> tokens;       // tokens lexed
+    static std::atomic<uint64_t> bytes;        // source bytes read
+    static std::atomic<uint64_t> allocations;  // Arena::Allocate calls, added up when an arena dies
+    static std::atomic<uint64_t> children;     // as/ld processes run
+    static std::atomic<uint64_t> childtime;    // their wall time, ns
+    static std::atomic<uint64_t> arenachunks;  // chunks mapped by Arena
+    static std::atomic<uint64_t> arenabytes;   // bytes mapped by Arena
+    static std::atomic<uint64_t> remotejobs;   // jobs done by workers
+    static std::atomic<uint64_t> remotebytes;  // bytes sent to and received from them
+
+private:
+    static void Report();
+    static void WriteTrace();
+
+    static bool enabled;
+};
+
+// records the lifetime of the enclosing scope as one trace event
+class ScopedTimer
+{
+public:
+    explicit ScopedTimer(const char *name)
+        : m_name(name), m_start(Profiler::Enabled() ? Profiler::Now() : 0) {}
+
+    ~ScopedTimer()
+    {
+        if (m_start) {
+            Profiler::Record(m_name, m_start, Profiler::Now());
+        }
+    }
+
+private:
+    const char *m_name;
+    uint64_t m_start;
+};
+
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef __REMOTE_H__
+#define __REMOTE_H__
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <cstdint>
+
+#include "argument.h"
+
+namespace c89 {
+
+/*
+ * Distributed compilation. The driver sends jobs to workers started
+ * with "c-- --worker [host:]port" and gets the object file back.
+ *
+ * Every message is a Frame, the input's name and the payload, LZ4
+ * compressed unless that does not make it smaller. Integers are in host
+ * byte order; workers and drivers run on the same x86-64 hosts.
+ *
+ * Only assembly is sent, and as gives the same object for the same text
+ * whatever -fPIC, -O or -g the driver was run with: those already shaped
+ * the text. A frame therefore carries no codegen options, and a worker
+ * fails jobs whose flags it does not know rather than ignore them.
+ */
+struct Frame
+{
+    char magic[4];          // "C--R"
+    uint16_t version;
+    uint16_t kind;          // FrameKind
+    uint32_t flags;         // reserved, 0
+    uint32_t namelen;
+    uint64_t rawsize;       // payload size
+    uint64_t size;          // on the wire, == rawsize if not compressed
+};
+
+enum FrameKind
+{
+    R_ASSEMBLE,             // assembly text -> R_OBJECT or R_FAILED
+    R_OBJECT,               // object file
+    R_FAILED,               // the job failed, compile it locally for the diagnostics
+};
+
+// one connection; its buffers are kept and reused for every message
+class Channel
+{
+public:
+    explicit Channel(int fd) : m_fd(fd) {}
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+    ~Channel();
+
+    bool Send(FrameKind kind, uint32_t flags, const std::string& name,
+              const char *data, size_t len);
+
+    // payload of the received frame is in Payload() until the next Receive
+    bool Receive(Frame& frame, std::string& name);
+    const std::string& Payload() const { return m_raw; }
+
+private:
+    bool ReadFull(char *buf, size_t len);
+
+private:
+    int m_fd;
+    std::string m_wire;     // compressed payload
+    std::string m_raw;      // received payload
+};
+
+/*
+ * A worker runs as on whatever it is sent, so it only takes connections
+ * from loopback and from the networks given with --worker-allow, and only
+ * binds a non-loopback address when such networks are given.
+ */
+class Worker
+{
+public:
+    // c-- --worker [host:]port, serves connections until killed
+    static int Listen(const std::string& addr, const std::vector<std::string>& allow);
+
+    // serve jobs on fd until the peer closes it
+    static void Serve(int fd);
+};
+
+/*
+ * Hands jobs to the workers of -fworkers=host:port,... ("local:N" starts
+ * N loopback workers in this process for testing). A job that can not be
+ * done remotely, because no worker is idle, reachable or successful, is
+ * left to the caller to compile locally.
+ */
+class Scheduler
+{
+public:
+    // null without -fworkers
+    static Scheduler* Get(const CcArg& arg);
+
+    ~Scheduler();
+
+    // assemble file into obj on a worker, false if it was not done
+    bool Assemble(const std::string& file, const std::string& obj);
+
+private:
+    explicit Scheduler(const std::vector<std::string>& workers);
+
+    static int Connect(const std::string& addr);
+    void StartLoopback(size_t n);
+
+private:
+    std::mutex lock;
+    std::vector<std::unique_ptr<Channel>> channels;
+    std::vector<Channel*> idle;
+    std::vector<std::thread> loopback;
+};
+
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef __TOKENFILE_H__
+#define __TOKENFILE_H__
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+#include "mappedfile.h"
+
+namespace c89 {
+
+class Token;
+
+/*
+ * Lexed translation unit on disk (.tok), used in place through mmap.
+ *
+ *   Header
+ *   Record[ntokens]     flat array
+ *   string table        identifier and string literal text, deduplicated
+ *   source              the TU the offsets and lengths refer to
+ *
+ * Records refer to strings and source text by offset, never by pointer.
+ * Integers are stored in host byte order (x86-64). Any change to the
+ * layout bumps VERSION; readers reject other versions.
+ */
+class TokenFile
+{
+public:
+    static const uint32_t VERSION = 2;
+
+    struct Header
+    {
+        char magic[4];          // "C--T"
+        uint32_t version;
+        uint64_t ntokens;
+        uint64_t tokoff;        // offsets from the start of the file
+        uint64_t stroff;
+        uint64_t strsize;
+        uint64_t srcoff;
+        uint64_t srcsize;
+    };
+
+    struct Record
+    {
+        uint8_t type;           // TokenType
+        uint8_t kind;           // Operators, Separators or NumType
+        uint16_t reserved;
+        uint32_t offset;        // in the source
+        uint32_t length;
+        uint32_t str;           // ident_name or string_literal, in the string table
+        uint32_t strlen;
+        int32_t character;      // char_literal
+        uint64_t number[2];     // number_literal
+    };
+
+    template <typename List>
+    static bool Write(const std::string& path, const List& tokens, const std::string& source)
+    {
+        std::vector<const Token*> toks;
+        for (const auto& t : tokens)
+        {
+            toks.push_back(&*t);
+        }
+        return Write(path, toks, source);
+    }
+
+    static bool Write(const std::string& path, const std::vector<const Token*>& tokens,
+                      const std::string& source);
+
+    // map and validate path
+    bool Open(const std::string& path);
+
+    size_t Count() const { return header->ntokens; }
+    const Record& operator[](size_t i) const { return records[i]; }
+    std::string String(const Record& r) const { return std::string(strings + r.str, r.strlen); }
+    std::string Source() const { return std::string(source, header->srcsize); }
+
+    // fill a token from its record
+    void Decode(const Record& r, Token& tok) const;
+
+private:
+    std::unique_ptr<MappedFile> file;
+
+    const Header *header = nullptr;
+    const Record *records = nullptr;
+    const char *strings = nullptr;
+    const char *source = nullptr;
+};
+
+}
+
+#endif
@@ -6,12 +6,16 @@
 #include <string>
 #include <memory>
 
+#include "arena.h"
 #include "files.h"
 #include "argument.h"
 #include "content.h"
+#include "diagnostic.h"
 
 namespace c89 {
 
+class TokenFile;
+
 enum TokenType
 {
   TK_IDENT,   // Identifiers
@@ -56,10 +60,10 @@ enum Operators
     /* comparison operator: ==, !=, <, <=, >, >= */
     O_EQUAL, O_NOTEQUAL, O_LOWER, O_LOWEQUAL, O_GREATER, O_GREAEQUAL,
 
-    /* assign operator: =, +=, -=, *=, /=, %=, <<=, >>=, &=, |=, ^=, ~= */
+    /* assign operator: =, +=, -=, *=, /=, %=, <<=, >>=, &=, |=, ^= */
     O_ASSIGN, O_PLUSASSIGN, O_SUBASSIGN, O_MULASSIGN, O_DIVASSIGN, O_COMPASSIGN, 
     O_SHLASSIGN, O_RHLASSIGN,
-    O_ANDASSIGN, O_ORASSIGN, O_XORASSIGN, O_NEGASSIGN,
+    O_ANDASSIGN, O_ORASSIGN, O_XORASSIGN,
 
     /* bit shifting: <<, >> */
     O_SHL, O_RHL,
@@ -80,11 +84,12 @@ enum Operators
 
 enum Separators
 {
-    /* , . : ; ( ) [ ] { } */
+    /* , . : ; ( ) [ ] { } ... */
     S_COMMA, S_DOT, S_COLON, S_EMICLON,
     S_LPARET, S_RPARET,      /* parentheses */
     S_LSQBRCKT, S_RSQBRCKT,  /* square bracket */
     S_LCUBRCKT, S_RCUBRCKT,  /* curly bracket */
+    S_ELLIPSIS,
     S_UNKNOWN,
 };
 
@@ -126,30 +131,46 @@ public:
     std::string ident_name;
 
     /* Token Location */
+    uint32_t offset;    // in the source
+    uint32_t length;
     unsigned int row;
     unsigned int column;
     std::string filename;
 };
 
+typedef ArenaList<std::shared_ptr<Token>> TokenList;
+
+// tokens and list nodes live in the tokenizer's arena, one per compilation unit
 class Tokenizer {
 public:
-    void TokenizeFiles(const CcArg& arg, const Files& files);
+    Tokenizer() : tokenlist(ArenaAllocator<std::shared_ptr<Token>>(arena)) {}
+
     void Tokenize(const CcArg& arg, const std::string& file, const std::string& content);
+    void Dump(const std::string& content);
+
+    // tokens of a .tok file instead of lexing
+    void Load(const TokenFile& file);
 
 private:
+    std::shared_ptr<Token> NewToken()
+    {
+        return std::allocate_shared<Token>(ArenaAllocator<Token>(arena));
+    }
+
     void TokenIdent(Content& c);
     void TokenPunct(Content& c);
     void TokenPlus(Content& c);
     void TokenSub(Content& c);
     void TokenChar(Content& c);
     void TokenNum(Content& c);
-    NumType SuffixType(Content& start, Content& end);
-    void TokenInteger(Content& start, Content& suffix, Content& end, int base);
-    void TokenFloat(Content& start,  Content& suffix, Content& end);
+    NumType SuffixType(const char *start, const char *end);
+    void TokenInteger(const char *start, const char *suffix, const char *end, int base, size_t offset);
+    void TokenFloat(const char *start, const char *suffix, const char *end, size_t offset);
     void TokenString(Content& c);
-    void EscapeChar(Content& c, int *character);
-    void OctalChar(Content& c, int *octal);
-    void HexChar(Content& c, int *hex);
+    bool SkipChar(Content& c);
+    bool EscapeChar(Content& c, int *character);
+    bool OctalChar(Content& c, int *octal);
+    bool HexChar(Content& c, int *hex);
     int HexchToint(char ch);
     void TokenMul(Content& c);
     void TokenDiv(Content& c);
@@ -174,8 +195,12 @@ private:
     void TokenLCubrckt(Content& c);
     void TokenRCubrckt(Content& c);
 
+private:
+    Arena arena;    // must outlive tokenlist
+
 public:
-    std::list<std::shared_ptr<Token>> tokenlist;
+    TokenList tokenlist;
+    Diagnostics diags;
 };
 
 }
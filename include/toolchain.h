@@ -0,0 +1,36 @@
+#ifndef __TOOLCHAIN_H__
+#define __TOOLCHAIN_H__
+
+#include <string>
+
+namespace c89 {
+
+// Result of toolchain discovery, persisted in Files::CacheDir()/toolchain
+// and keyed by the mtimes of the probed directories.
+class Toolchain
+{
+public:
+    static const Toolchain& Probe();
+
+    // crt1.o, crti.o, crtn.o
+    static std::string FindGlibCrt();
+
+    // crtbegin.o  crtend.o
+    static std::string FindGccLibCrt(unsigned int version);
+
+    static unsigned int GetGccVersion();
+
+private:
+    static std::string CacheKey();
+    bool LoadCache(const std::string& path, const std::string& key);
+    void SaveCache(const std::string& path, const std::string& key) const;
+
+public:
+    std::string glibcrt;        // directory of crt1.o, crti.o, crtn.o
+    std::string gcclibcrt;      // directory of crtbegin.o, crtend.o
+    unsigned int gccversion = 0;
+};
+
+}
+
+#endif
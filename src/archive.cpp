@@ -0,0 +1,283 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "files.h"
+#include "archive.h"
+
+namespace c89 {
+
+static const char *index_magic = "c--aidx1";
+static const size_t ar_hdrsize = 60;
+
+static inline size_t Align8(size_t n)
+{
+    return (n + 7) & ~(size_t)7;
+}
+
+// FNV-1a, stable across runs unlike std::hash
+uint32_t ArchiveIndex::Hash(const char *str, size_t len)
+{
+    uint32_t h {2166136261u};
+
+    for (size_t i = 0; i < len; i++)
+    {
+        h = (h ^ (uint8_t)str[i]) * 16777619u;
+    }
+
+    return h;
+}
+
+std::string ArchiveIndex::CachePath(const std::string& path)
+{
+    char name[32];
+    auto dir = Files::CacheDir();
+
+    if (dir.empty()) {
+        return "";
+    }
+
+    dir += "/archives";
+    if (mkdir(dir.c_str(), 0755) && errno != EEXIST) {
+        return "";
+    }
+
+    snprintf(name, sizeof(name), "/%08x.idx", Hash(path.data(), path.size()));
+    return dir + name;
+}
+
+bool ArchiveIndex::Load(const std::string& path, const MappedFile& ar)
+{
+    auto cachepath = CachePath(path);
+
+    if (!cachepath.empty()) {
+        cache.reset(new MappedFile);
+
+        if (cache->Open(cachepath) && Map(cache->data, cache->size)) {
+            const Header *h = header;
+            const char *p = (const char *)(h + 1);
+
+            if (h->ino == (uint64_t)ar.st.st_ino && h->size == (uint64_t)ar.st.st_size &&
+                h->mtime_sec == (uint64_t)ar.st.st_mtim.tv_sec &&
+                h->mtime_nsec == (uint64_t)ar.st.st_mtim.tv_nsec &&
+                h->pathlen == path.size() && !memcmp(p, path.data(), path.size())) {
+                return true;
+            }
+        }
+
+        cache.reset();
+    }
+
+    if (!Build(path, ar)) {
+        return false;
+    }
+
+    if (!cachepath.empty()) {
+        Save(cachepath);
+    }
+
+    return true;
+}
+
+size_t ArchiveIndex::Find(const std::string& name) const
+{
+    uint32_t mask = header->nbuckets - 1;
+    uint32_t i = Hash(name.data(), name.size()) & mask;
+
+    // Map() made sure there is an empty bucket, the bound is only a backstop
+    for (uint32_t n = 0; buckets[i] && n < header->nbuckets; i = (i + 1) & mask, n++)
+    {
+        const Entry& e = entries[buckets[i] - 1];
+
+        if (e.len == name.size() && !memcmp(strings + e.name, name.data(), e.len)) {
+            return e.member;
+        }
+    }
+
+    return npos;
+}
+
+// parse the archive symbol table into the cache layout
+bool ArchiveIndex::Build(const std::string& path, const MappedFile& ar)
+{
+    size_t width {0};
+    const uint8_t *data = ar.data;
+
+    if (ar.size < 8 + ar_hdrsize) {
+        return false;
+    }
+
+    const char *hdr = (const char *)data + 8;
+    size_t msize = strtoul(std::string(hdr + 48, 10).c_str(), nullptr, 10);
+    const uint8_t *p = data + 8 + ar_hdrsize;
+
+    if (!memcmp(hdr, "/               ", 16)) {
+        width = 4;
+    } else if (!memcmp(hdr, "/SYM64/         ", 16)) {
+        width = 8;
+    } else {
+        // no symbol index, ld would reject it as well
+        return false;
+    }
+
+    if (8 + ar_hdrsize + msize > ar.size || msize < width) {
+        return false;
+    }
+
+    auto readbe = [width](const uint8_t *q) {
+        uint64_t v {0};
+        for (size_t i = 0; i < width; i++)
+        {
+            v = (v << 8) | q[i];
+        }
+        return v;
+    };
+
+    uint64_t count = readbe(p);
+    if (count > msize / width - 1) {
+        return false;
+    }
+
+    const uint8_t *offsets = p + width;
+    const char *names = (const char *)(offsets + count * width);
+    const char *end = (const char *)p + msize;
+    size_t strsize = end > names ? end - names : 0;
+
+    uint32_t nbuckets {16};
+    while (nbuckets < count * 2)
+    {
+        nbuckets <<= 1;
+    }
+
+    size_t pathoff = sizeof(Header);
+    size_t bucketoff = Align8(pathoff + path.size());
+    size_t entryoff = Align8(bucketoff + nbuckets * sizeof(uint32_t));
+    size_t stroff = entryoff + count * sizeof(Entry);
+
+    image.assign((stroff + strsize + 7) / 8, 0);
+    uint8_t *base = (uint8_t *)image.data();
+
+    Header *h = (Header *)base;
+    memcpy(h->magic, index_magic, 8);
+    h->ino = ar.st.st_ino;
+    h->size = ar.st.st_size;
+    h->mtime_sec = ar.st.st_mtim.tv_sec;
+    h->mtime_nsec = ar.st.st_mtim.tv_nsec;
+    h->nbuckets = nbuckets;
+    h->pathlen = path.size();
+    h->strsize = strsize;
+    h->stroff = stroff;
+    memcpy(base + pathoff, path.data(), path.size());
+    memcpy(base + stroff, names, strsize);
+
+    uint32_t *bkts = (uint32_t *)(base + bucketoff);
+    Entry *ents = (Entry *)(base + entryoff);
+    const char *strs = (const char *)(base + stroff);
+    uint32_t n {0};
+    size_t pos {0};
+
+    for (uint64_t i = 0; i < count && pos < strsize; i++)
+    {
+        size_t len = strnlen(strs + pos, strsize - pos);
+        uint32_t b = Hash(strs + pos, len) & (nbuckets - 1);
+        bool dup {false};
+
+        // the first member defining a symbol wins, as in ld
+        for (; bkts[b]; b = (b + 1) & (nbuckets - 1))
+        {
+            const Entry& e = ents[bkts[b] - 1];
+            if (e.len == len && !memcmp(strs + e.name, strs + pos, len)) {
+                dup = true;
+                break;
+            }
+        }
+
+        if (!dup) {
+            ents[n].member = readbe(offsets + i * width);
+            ents[n].name = pos;
+            ents[n].len = len;
+            bkts[b] = ++n;
+        }
+
+        pos += len + 1;
+    }
+    h->nentries = n;
+
+    return Map(base, image.size() * 8);
+}
+
+// validate a table image and point the lookup fields into it
+bool ArchiveIndex::Map(const uint8_t *data, size_t size)
+{
+    const Header *h = (const Header *)data;
+
+    if (size < sizeof(Header) || memcmp(h->magic, index_magic, 8) ||
+        !h->nbuckets || (h->nbuckets & (h->nbuckets - 1)) || h->nentries >= h->nbuckets) {
+        return false;
+    }
+
+    size_t bucketoff = Align8(sizeof(Header) + h->pathlen);
+    size_t entryoff = Align8(bucketoff + (size_t)h->nbuckets * sizeof(uint32_t));
+
+    // the entry table may have room for duplicates, so stroff is stored
+    if (h->stroff < entryoff + (size_t)h->nentries * sizeof(Entry) ||
+        h->stroff > size || size - h->stroff < h->strsize) {
+        return false;
+    }
+
+    const uint32_t *bkts = (const uint32_t *)(data + bucketoff);
+    const Entry *ents = (const Entry *)(data + entryoff);
+
+    // bucket values may repeat in a damaged table, so count the empty ones:
+    // without one, a lookup of a missing name would never stop
+    uint32_t empty {0};
+
+    for (uint32_t i = 0; i < h->nbuckets; i++)
+    {
+        if (bkts[i] > h->nentries) {
+            return false;
+        }
+        empty += !bkts[i];
+    }
+
+    if (!empty) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < h->nentries; i++)
+    {
+        if ((uint64_t)ents[i].name + ents[i].len > h->strsize) {
+            return false;
+        }
+    }
+
+    header = h;
+    buckets = bkts;
+    entries = ents;
+    strings = (const char *)data + h->stroff;
+
+    return true;
+}
+
+void ArchiveIndex::Save(const std::string& cachepath) const
+{
+    FILE *fp;
+    auto tmp = cachepath + "." + std::to_string(getpid());
+
+    fp = fopen(tmp.c_str(), "w");
+    if (!fp) {
+        return;
+    }
+
+    size_t n = fwrite(image.data(), 8, image.size(), fp);
+
+    if (fclose(fp) || n != image.size() || rename(tmp.c_str(), cachepath.c_str())) {
+        unlink(tmp.c_str());
+    }
+}
+
+}
@@ -0,0 +1,48 @@
+#include <new>
+
+#include <sys/mman.h>
+
+#include "arena.h"
+#include "profile.h"
+
+namespace c89 {
+
+Arena::~Arena()
+{
+    // one shared counter update per arena instead of one per allocation
+    if (m_allocs) {
+        Profiler::allocations += m_allocs;
+    }
+
+    for (auto& c : m_chunks)
+    {
+        munmap(c.base, c.size);
+    }
+}
+
+char* Arena::Grow(size_t size, size_t align)
+{
+    size_t bytes = size + align > m_chunksize ? size + align : m_chunksize;
+    bytes = (bytes + 4095) & ~(size_t)4095;
+
+    // chunks are filled front to back, fault them in with one call
+    void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (p == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+
+    m_chunks.push_back(Chunk {(char *)p, bytes});
+
+    // small inputs stay small, larger ones quickly reach maxchunk
+    m_chunksize = m_chunksize < maxchunk / 2 ? m_chunksize * 2 : (size_t)maxchunk;
+
+    Profiler::arenachunks++;
+    Profiler::arenabytes += bytes;
+
+    Chunk& c = m_chunks.back();
+    m_end = c.base + c.size;
+
+    return (char *)(((uintptr_t)c.base + align - 1) & ~(uintptr_t)(align - 1));
+}
+
+}
@@ -1,6 +1,9 @@
 #include <cstring>
 #include <cstdlib>
+#include <cerrno>
+#include <climits>
 #include <iostream>
+#include <algorithm>
 
 #include "log.h"
 #include "argument.h"
@@ -49,6 +52,121 @@ void CcArg::ParseArgs(int argc, char **argv)
             continue;
         }
 
+        if (!strcmp(argv[i], "-nostdlib")) {
+            opt_nostdlib = true;
+            continue;
+        }
+
+        if (!strcmp(argv[i], "-fbuiltin-ld")) {
+            opt_builtin_ld = true;
+            continue;
+        }
+
+        if (!strcmp(argv[i], "-ftime-report")) {
+            opt_time_report = true;
+            continue;
+        }
+
+        if (!strcmp(argv[i], "-dump-tokens")) {
+            opt_dump_tokens = true;
+            continue;
+        }
+
+        if (!strcmp(argv[i], "-emit-tokens")) {
+            opt_emit_tokens = true;
+            continue;
+        }
+
+        if (!strcmp(argv[i], "--worker")) {
+            if (i+1 < argc) {
+                opt_worker = true;
+                workeraddr = argv[++i];
+                continue;
+            }
+            Error::Fatal("option '--worker' need argument");
+        }
+
+        if (!strcmp(argv[i], "--worker-allow")) {
+            if (i+1 < argc) {
+                ParseOptWl(argv[++i], workerallow);
+                continue;
+            }
+            Error::Fatal("option '--worker-allow' need argument");
+        }
+
+        if (!strncmp(argv[i], "-fworkers=", 10)) {
+            ParseOptWl(argv[i]+10, workers);
+            for (const auto& w : workers)
+            {
+                if (!w.compare(0, 6, "local:")) {
+                    CheckLoopbackWorkers(w.c_str() + 6);
+                }
+            }
+            continue;
+        }
+
+        if (!strncmp(argv[i], "-finline-limit=", 15)) {
+            const char *n = argv[i]+15;
+            if (!*n || strspn(n, "0123456789") != strlen(n)) {
+                Error::Fatal(std::string("invalid argument to '-finline-limit=': ") + n);
+            }
+            errno = 0;
+            unsigned long limit = strtoul(n, nullptr, 10);
+            if (errno == ERANGE || limit > UINT_MAX) {
+                Error::Fatal(std::string("argument to '-finline-limit=' is out of range: ") + n);
+            }
+            inline_limit = limit;
+            Error::Warning("'-finline-limit=' has no effect until c-- has a code generator");
+            continue;
+        }
+
+        if (!strcmp(argv[i], "-fprofile-generate") || !strncmp(argv[i], "-fprofile-generate=", 19)) {
+            opt_profile_generate = true;
+            if (argv[i][18] == '=') {
+                profilepath = argv[i]+19;
+            }
+            Error::Warning("'-fprofile-generate' has no effect until c-- has a code generator");
+            continue;
+        }
+
+        if (!strcmp(argv[i], "-fprofile-use") || !strncmp(argv[i], "-fprofile-use=", 14)) {
+            opt_profile_use = true;
+            if (argv[i][13] == '=') {
+                profilepath = argv[i]+14;
+            }
+            Error::Warning("'-fprofile-use' has no effect until c-- has a code generator");
+            continue;
+        }
+
+        if (!strcmp(argv[i], "-flto") || !strcmp(argv[i], "-fno-lto")) {
+            opt_flto = argv[i][2] != 'n';
+            if (opt_flto) {
+                Error::Warning("'-flto' has no effect until c-- has a code generator");
+            }
+            continue;
+        }
+
+        if (!strncmp(argv[i], "-ftrace=", 8)) {
+            tracefile = argv[i]+8;
+            if (tracefile.empty()) {
+                Error::Fatal("option '-ftrace=' need argument");
+            }
+            continue;
+        }
+
+        if (!strcmp(argv[i], "-mavx2") || !strcmp(argv[i], "-mno-avx2")) {
+            opt_mavx2 = argv[i][2] != 'n';
+            if (opt_mavx2) {
+                Error::Warning("'-mavx2' has no effect until c-- has a code generator");
+            }
+            continue;
+        }
+
+        if (!strncmp(argv[i], "-O", 2)) {
+            ParseOptO(argv[i]+2);
+            continue;
+        }
+
         if (!strcmp(argv[i], "-x")) {
             if (i+1 < argc) {
                 input_type = ParseOptx(argv[++i]);
@@ -126,7 +244,7 @@ void CcArg::ParseArgs(int argc, char **argv)
     }
 
     // check arguments
-    if (input.size() == 0) {
+    if (input.size() == 0 && !opt_worker) {
         Error::Fatal("no input files");
     }
 
@@ -137,6 +255,51 @@ void CcArg::ParseArgs(int argc, char **argv)
     }
 }
 
+// -O, -O<n>, -Os, -Oz, -Og, -Ofast as gcc takes them, levels above 3 are 3
+void CcArg::ParseOptO(const std::string& arg)
+{
+    opt_Os = false;
+
+    // -Og is a debugging -O1, -Oz a smaller -Os
+    if (arg.empty() || arg == "g") {
+        opt_level = 1;
+    } else if (arg == "s" || arg == "z") {
+        opt_level = 2;
+        opt_Os = true;
+    } else if (arg == "fast") {
+        opt_level = 3;
+    } else if (arg.find_first_not_of("0123456789") == arg.npos) {
+        errno = 0;
+        unsigned long level = strtoul(arg.c_str(), nullptr, 10);
+        if (errno == ERANGE || level > INT_MAX) {
+            Error::Fatal("optimization level '-O" + arg + "' is out of range");
+        }
+        opt_level = std::min((int)level, 3);
+    } else {
+        Error::Fatal("invalid optimization level '-O" + arg + "'");
+    }
+
+    if (opt_level > 0) {
+        Error::Warning("'-O" + arg + "' has no effect until c-- has a code generator");
+    }
+}
+
+// N of -fworkers=local:N, threads started in this process
+void CcArg::CheckLoopbackWorkers(const char *n)
+{
+    static const unsigned long maxworkers = 256;
+
+    if (!*n || strspn(n, "0123456789") != strlen(n)) {
+        Error::Fatal(std::string("invalid worker count in '-fworkers=local:': ") + n);
+    }
+
+    errno = 0;
+    unsigned long count = strtoul(n, nullptr, 10);
+    if (errno == ERANGE || count > maxworkers) {
+        Error::Fatal(std::string("worker count in '-fworkers=local:' is out of range: ") + n);
+    }
+}
+
 Languages CcArg::ParseOptx(const std::string& arg)
 {
     if (arg == "c") {
@@ -1,44 +1,31 @@
-#include <unistd.h>
-#include <sys/stat.h>
-#include <sys/wait.h>
-
+#include "profile.h"
+#include "process.h"
 #include "assemble.h"
 
 namespace c89 {
 
-void Assembler::Assemble(const CcArg& arg, Files& files)
+bool Assembler::AssembleFile(const std::string& file, const std::string& obj)
 {
-    std::vector<const char *> cmds {"as", "-c", nullptr, "-o", nullptr, nullptr};
-
-    for (const auto &vec : {files.asmfiles, files.tmpasmfiles})
-    {
-        for (const auto &f : vec)
-        {
-            cmds[2] = f.c_str();
-            cmds[4] = Files::BaseName(Files::ConvertTo(f, OBJ_FILE)).c_str();
+    std::vector<const char *> cmds {"as", "-c", file.c_str(), "-o", obj.c_str(), nullptr};
 
-            // run as command
-            if (fork() == 0) {
-                execvp(cmds[0], (char *const*)cmds.data());
-                exit(1);
-            }
+    // run as command
+    ScopedTimer t("as");
 
-            wait(nullptr);
-
-            files.tmpobjfiles.emplace_back(cmds[4]);
-        }
-    }
+    return Process::Run(cmds) == 0;
+}
 
+void Assembler::Finish(const CcArg& arg, Files& files)
+{
     // c-- xxx -c
     // c-- xxx -c -o output
     if (arg.opt_c) {
-        if (arg.opt_o) {
+        // nothing to rename until c-- has a code generator for .c input
+        if (arg.opt_o && !files.tmpobjfiles.empty()) {
             Files::RenameFile(files.tmpobjfiles[0], arg.output);
         }
 
         files.tmpobjfiles.clear();
-        exit(0);
     }
 }
 
-} 
\ No newline at end of file
+}
@@ -0,0 +1,187 @@
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include "compress.h"
+
+namespace c89 {
+
+static const size_t MINMATCH = 4;
+static const size_t LASTLITERALS = 5;   // the block ends with literals
+static const size_t MFLIMIT = 12;       // no match starts this close to the end
+static const size_t MAXOFFSET = 65535;
+static const int HASHLOG = 12;
+
+static inline uint32_t Read32(const char *p)
+{
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static inline uint32_t Hash(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - HASHLOG);
+}
+
+static void PutLength(std::string& out, size_t len)
+{
+    for (; len >= 255; len -= 255)
+    {
+        out += (char)255;
+    }
+    out += (char)len;
+}
+
+static void PutSequence(std::string& out, const char *lit, size_t nlit, size_t offset, size_t mlen)
+{
+    size_t m = mlen ? mlen - MINMATCH : 0;
+    unsigned char token = (nlit < 15 ? nlit : 15) << 4 | (m < 15 ? m : 15);
+
+    out += (char)token;
+    if (nlit >= 15) {
+        PutLength(out, nlit - 15);
+    }
+    out.append(lit, nlit);
+
+    // the last sequence has literals only
+    if (!mlen) {
+        return;
+    }
+
+    out += (char)(offset & 0xff);
+    out += (char)(offset >> 8);
+    if (m >= 15) {
+        PutLength(out, m - 15);
+    }
+}
+
+void Lz4::Compress(const char *src, size_t len, std::string& out)
+{
+    std::vector<uint32_t> table(1 << HASHLOG, 0);
+    const char *anchor = src;
+    const char *end = src + len;
+    const char *p = src + 1;
+
+    out.clear();
+    out.reserve(len + len / 255 + 16);
+
+    if (len < MFLIMIT + 1) {
+        PutSequence(out, src, len, 0, 0);
+        return;
+    }
+
+    const char *mflimit = end - MFLIMIT;
+    const char *matchlimit = end - LASTLITERALS;
+
+    // positions are stored +1, 0 means empty
+    table[Hash(Read32(src))] = 1;
+
+    while (p < mflimit)
+    {
+        uint32_t h = Hash(Read32(p));
+        const char *ref = table[h] ? src + table[h] - 1 : nullptr;
+        table[h] = p - src + 1;
+
+        if (!ref || p - ref > (ptrdiff_t)MAXOFFSET || Read32(ref) != Read32(p)) {
+            p++;
+            continue;
+        }
+
+        // extend backwards over pending literals, then forwards
+        while (p > anchor && ref > src && p[-1] == ref[-1])
+        {
+            p--;
+            ref--;
+        }
+
+        const char *q = p + MINMATCH;
+        const char *r = ref + MINMATCH;
+        while (q < matchlimit && *q == *r)
+        {
+            q++;
+            r++;
+        }
+
+        PutSequence(out, anchor, p - anchor, p - ref, q - p);
+
+        p = anchor = q;
+        if (p < mflimit) {
+            table[Hash(Read32(p - 2))] = p - 2 - src + 1;
+        }
+    }
+
+    PutSequence(out, anchor, end - anchor, 0, 0);
+}
+
+bool Lz4::Decompress(const char *src, size_t len, char *dst, size_t rawsize)
+{
+    const unsigned char *ip = (const unsigned char *)src;
+    const unsigned char *iend = ip + len;
+    char *op = dst;
+    char *oend = dst + rawsize;
+
+    while (ip < iend)
+    {
+        unsigned token = *ip++;
+        size_t nlit = token >> 4;
+
+        if (nlit == 15) {
+            unsigned char b;
+            do {
+                if (ip >= iend) {
+                    return false;
+                }
+                b = *ip++;
+                nlit += b;
+            } while (b == 255);
+        }
+
+        if (nlit > (size_t)(iend - ip) || nlit > (size_t)(oend - op)) {
+            return false;
+        }
+        memcpy(op, ip, nlit);
+        op += nlit;
+        ip += nlit;
+
+        // end of block
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        size_t offset = ip[0] | ip[1] << 8;
+        ip += 2;
+
+        size_t mlen = token & 15;
+        if (mlen == 15) {
+            unsigned char b;
+            do {
+                if (ip >= iend) {
+                    return false;
+                }
+                b = *ip++;
+                mlen += b;
+            } while (b == 255);
+        }
+        mlen += MINMATCH;
+
+        if (offset == 0 || offset > (size_t)(op - dst) || mlen > (size_t)(oend - op)) {
+            return false;
+        }
+
+        // matches may overlap their own output
+        const char *ref = op - offset;
+        for (size_t i = 0; i < mlen; i++)
+        {
+            op[i] = ref[i];
+        }
+        op += mlen;
+    }
+
+    return op == oend;
+}
+
+}
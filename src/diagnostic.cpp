@@ -0,0 +1,94 @@
+#include <cerrno>
+#include <algorithm>
+
+#include <unistd.h>
+
+#include "diagnostic.h"
+
+namespace c89 {
+
+// %c is replaced by Diagnostic::arg
+static const char *messages[] = {
+    "Unrecognized Character",
+    "Missing terminating \" character",
+    "invalid suffix on int constant",
+    "invalid suffix on float constant",
+    "invalid suffix '%c'",
+    "empty character constant",
+    "Multi-character character constant",
+    "unknown escape character \\%c",
+    "used with no following hex digits",
+    "unknown punct: %c",
+    "Missing terminating ' character",
+    "escape sequence out of range",
+    "invalid digit '%c' in octal constant",
+    "integer constant is too large",
+    "exponent has no digits",
+};
+
+void Diagnostics::Report(const std::string& file, const std::string& content)
+{
+    std::string out;
+    size_t pos = 0, line = 0;
+    unsigned int row = 1;
+
+    // one pass over the source, in offset order
+    std::stable_sort(m_diags.begin(), m_diags.end(),
+                     [](const Diagnostic& a, const Diagnostic& b) { return a.offset < b.offset; });
+
+    for (const auto& d : m_diags)
+    {
+        size_t offset = std::min<size_t>(d.offset, content.size());
+
+        for (; pos < offset; pos++)
+        {
+            if (content[pos] == '\n') {
+                row++;
+                line = pos + 1;
+            }
+        }
+
+        size_t end = content.find('\n', line);
+        if (end == std::string::npos) {
+            end = content.size();
+        }
+
+        out += "\e[1;31merror: \e[0m";
+        out += file + ":" + std::to_string(row) + ":" + std::to_string(offset - line) + " ";
+
+        for (const char *m = messages[d.code]; *m; m++)
+        {
+            if (m[0] == '%' && m[1] == 'c') {
+                out += d.arg;
+                m++;
+            } else {
+                out += *m;
+            }
+        }
+
+        out += "\n\t\t" + std::to_string(row) + " | ";
+        out.append(content, line, end - line);
+        out += "\n";
+    }
+
+    const char *p = out.data();
+    size_t left = out.size();
+
+    while (left > 0)
+    {
+        ssize_t n = write(STDERR_FILENO, p, left);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+
+        p += n;
+        left -= n;
+    }
+
+    m_diags.clear();
+}
+
+}
@@ -0,0 +1,1363 @@
+#include <atomic>
+#include <algorithm>
+
+#include <cstring>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "profile.h"
+#include "parallel.h"
+#include "elflinker.h"
+
+namespace c89 {
+
+static const uint64_t image_base = 0x400000;
+static const uint64_t page_size = 0x1000;
+
+static const char *ar_magic = "!<arch>\n";
+static const size_t ar_hdrsize = 60;
+
+// output section order inside the executable
+enum SectionClass
+{
+    SC_TEXT,    // r-x
+    SC_RODATA,  // r--
+    SC_DATA,    // rw-
+    SC_BSS,     // rw-, no file space
+};
+
+// sections that are merged into one output section with their .xxx.* variants
+static const char *merge_prefixes[] = {
+    ".text", ".rodata", ".data.rel.ro", ".data", ".bss",
+    ".init_array", ".fini_array", ".preinit_array",
+    ".gcc_except_table", ".eh_frame",
+};
+
+// symbols the linker defines when they are referenced but not defined
+static const char *synthetic_names[] = {
+    "__executable_start", "__ehdr_start",
+    "_etext", "etext", "__etext",
+    "_edata", "edata", "__bss_start",
+    "_end", "end",
+    "_GLOBAL_OFFSET_TABLE_",
+    "__preinit_array_start", "__preinit_array_end",
+    "__init_array_start", "__init_array_end",
+    "__fini_array_start", "__fini_array_end",
+    "__rela_iplt_start", "__rela_iplt_end",
+};
+
+static inline uint64_t AlignTo(uint64_t value, uint64_t align)
+{
+    return align > 1 ? (value + align - 1) & ~(align - 1) : value;
+}
+
+static inline bool IsRegularIndex(uint32_t shndx)
+{
+    return shndx != SHN_UNDEF && shndx < SHN_LORESERVE;
+}
+
+static inline bool IsDefined(const ElfSymbol *sym)
+{
+    return sym->file || sym->synthetic;
+}
+
+static SectionClass ClassOf(const OutputSection& out)
+{
+    if (out.flags & SHF_EXECINSTR) {
+        return SC_TEXT;
+    }
+
+    if (!(out.flags & SHF_WRITE)) {
+        return SC_RODATA;
+    }
+
+    return out.type == SHT_NOBITS ? SC_BSS : SC_DATA;
+}
+
+ElfSymbol* SymbolMap::Insert(const std::string& name, std::unique_lock<std::mutex>& lock)
+{
+    Shard& shard = shards[std::hash<std::string>()(name) % 64];
+    lock = std::unique_lock<std::mutex>(shard.lock);
+
+    auto it = shard.map.find(name);
+    if (it != shard.map.end()) {
+        return it->second;
+    }
+
+    shard.symbols.emplace_back();
+    ElfSymbol *sym = &shard.symbols.back();
+    sym->name = name;
+    sym->bind = STB_WEAK;
+    shard.map.emplace(name, sym);
+
+    return sym;
+}
+
+ElfSymbol* SymbolMap::Find(const std::string& name)
+{
+    Shard& shard = shards[std::hash<std::string>()(name) % 64];
+    std::lock_guard<std::mutex> lock(shard.lock);
+
+    auto it = shard.map.find(name);
+    return it == shard.map.end() ? nullptr : it->second;
+}
+
+bool ElfLinker::Link(const std::string& output, const std::vector<std::string>& inputs,
+                     std::string *why)
+{
+    ElfLinker ld;
+    bool ok = ld.Run(output, inputs);
+
+    if (!ok && why) {
+        *why = ld.error;
+    }
+
+    return ok;
+}
+
+bool ElfLinker::Run(const std::string& output, const std::vector<std::string>& inputs)
+{
+    {
+        ScopedTimer t("ld: read inputs");
+        if (!AddFiles(inputs)) {
+            return false;
+        }
+    }
+
+    {
+        ScopedTimer t("ld: archives");
+        if (!ResolveArchives()) {
+            return false;
+        }
+    }
+
+    {
+        ScopedTimer t("ld: layout");
+        Layout();
+
+        if (!DefineSynthetic() || !ScanRelocations()) {
+            return false;
+        }
+
+        AssignAddresses();
+        BuildSymbolTable();
+    }
+
+    ScopedTimer t("ld: write");
+    return Write(output);
+}
+
+// tasks run concurrently, the first reason wins
+bool ElfLinker::Reject(const std::string& reason)
+{
+    std::lock_guard<std::mutex> lock(errlock);
+
+    if (error.empty()) {
+        error = reason;
+    }
+
+    return false;
+}
+
+// map and parse every input concurrently, then resolve their symbols
+bool ElfLinker::AddFiles(const std::vector<std::string>& paths)
+{
+    size_t n = paths.size();
+    std::atomic<bool> ok {true};
+    std::vector<std::unique_ptr<MappedFile>> files(n);
+    std::vector<std::unique_ptr<ElfObject>> objs(n);
+    std::vector<std::unique_ptr<ElfArchive>> ars(n);
+
+    Parallel::For(n, [&](size_t i) {
+        files[i].reset(new MappedFile);
+
+        if (!files[i]->Open(paths[i])) {
+            ok = Reject(paths[i] + ": can not be read");
+            return;
+        }
+
+        const uint8_t *data = files[i]->data;
+        size_t size = files[i]->size;
+
+        if (size >= 8 && !memcmp(data, ar_magic, 8)) {
+            // only the symbol index is read, members are extracted on demand
+            ars[i].reset(new ElfArchive);
+            ars[i]->name = paths[i];
+            ars[i]->file = files[i].get();
+            if (!ars[i]->index.Load(paths[i], *files[i])) {
+                ok = Reject(paths[i] + ": bad archive symbol index");
+            }
+        } else {
+            objs[i] = NewObject(paths[i], data, size, i);
+            if (!objs[i]) {
+                ok = false;
+            }
+        }
+    });
+
+    if (!ok) {
+        return false;
+    }
+
+    size_t from = objects.size();
+    nextpriority = n;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        mapped.emplace_back(std::move(files[i]));
+        if (ars[i]) {
+            archives.emplace_back(std::move(ars[i]));
+        } else {
+            objects.emplace_back(std::move(objs[i]));
+        }
+    }
+
+    return ResolveObjects(from);
+}
+
+std::unique_ptr<ElfObject> ElfLinker::NewObject(const std::string& name, const uint8_t *data,
+                                                size_t size, uint32_t priority)
+{
+    std::unique_ptr<ElfObject> obj {new ElfObject};
+
+    obj->name = name;
+    obj->size = size;
+    obj->priority = priority;
+
+    // archive members are only 2-byte aligned
+    if ((uintptr_t)data % 8) {
+        obj->storage.resize((size + 7) / 8);
+        memcpy(obj->storage.data(), data, size);
+        data = (const uint8_t *)obj->storage.data();
+    }
+    obj->data = data;
+
+    if (!ParseObject(*obj)) {
+        obj.reset();
+    }
+
+    return obj;
+}
+
+bool ElfLinker::ParseObject(ElfObject& obj)
+{
+    const Elf64_Ehdr *ehdr = (const Elf64_Ehdr *)obj.data;
+
+    auto bad = [&obj, this](const std::string& what) {
+        return Reject(obj.name + ": " + what);
+    };
+
+    // offset + size > limit without wrapping around
+    auto outside = [](uint64_t offset, uint64_t size, uint64_t limit) {
+        return offset > limit || size > limit - offset;
+    };
+
+    if (obj.size < sizeof(Elf64_Ehdr) || memcmp(ehdr->e_ident, ELFMAG, SELFMAG) ||
+        ehdr->e_ident[EI_CLASS] != ELFCLASS64 || ehdr->e_ident[EI_DATA] != ELFDATA2LSB ||
+        ehdr->e_type != ET_REL || ehdr->e_machine != EM_X86_64) {
+        return bad("not an x86-64 relocatable object");
+    }
+
+    if (ehdr->e_shentsize != sizeof(Elf64_Shdr) || ehdr->e_shnum == 0 ||
+        outside(ehdr->e_shoff, ehdr->e_shnum * sizeof(Elf64_Shdr), obj.size) ||
+        ehdr->e_shstrndx >= ehdr->e_shnum) {
+        return bad("bad section header table");
+    }
+
+    uint32_t shnum = ehdr->e_shnum;
+    obj.shdrs = (const Elf64_Shdr *)(obj.data + ehdr->e_shoff);
+    obj.sections.resize(shnum);
+
+    const Elf64_Shdr& shstr = obj.shdrs[ehdr->e_shstrndx];
+    if (shstr.sh_type != SHT_STRTAB || shstr.sh_size == 0 ||
+        outside(shstr.sh_offset, shstr.sh_size, obj.size) ||
+        obj.data[shstr.sh_offset + shstr.sh_size - 1] != '\0') {
+        return bad("bad section name table");
+    }
+    const char *shnames = (const char *)obj.data + shstr.sh_offset;
+
+    const Elf64_Shdr *symsec = nullptr;
+
+    for (uint32_t i = 1; i < shnum; i++)
+    {
+        const Elf64_Shdr& sh = obj.shdrs[i];
+
+        if (sh.sh_type != SHT_NOBITS && outside(sh.sh_offset, sh.sh_size, obj.size)) {
+            return bad("section " + std::to_string(i) + " extends past the end of the file");
+        }
+
+        if (sh.sh_name >= shstr.sh_size) {
+            return bad("section " + std::to_string(i) + " has a bad name");
+        }
+
+        switch (sh.sh_type)
+        {
+        case SHT_SYMTAB:
+            symsec = &sh;
+            break;
+        case SHT_GROUP:
+        case SHT_REL:
+        case SHT_SYMTAB_SHNDX:
+            return bad(std::string("unsupported section ") + (shnames + sh.sh_name));
+        case SHT_PROGBITS:
+        case SHT_NOBITS:
+        case SHT_INIT_ARRAY:
+        case SHT_FINI_ARRAY:
+        case SHT_PREINIT_ARRAY:
+        case SHT_X86_64_UNWIND:
+            if (!(sh.sh_flags & SHF_ALLOC)) {
+                break;
+            }
+
+            if (sh.sh_flags & SHF_TLS) {
+                return bad(std::string("unsupported TLS section ") + (shnames + sh.sh_name));
+            }
+
+            obj.sections[i].reset(new InputSection);
+            obj.sections[i]->file = &obj;
+            obj.sections[i]->shdr = &sh;
+            obj.sections[i]->name = shnames + sh.sh_name;
+            break;
+        case SHT_NOTE:
+        case SHT_RELA:
+        case SHT_STRTAB:
+            break;
+        default:
+            if (sh.sh_flags & SHF_ALLOC) {
+                return bad(std::string("unsupported section ") + (shnames + sh.sh_name));
+            }
+        }
+    }
+
+    // attach relocations to the sections we keep
+    for (uint32_t i = 1; i < shnum; i++)
+    {
+        const Elf64_Shdr& sh = obj.shdrs[i];
+
+        if (sh.sh_type != SHT_RELA || sh.sh_info >= shnum || !obj.sections[sh.sh_info]) {
+            continue;
+        }
+
+        if (sh.sh_entsize != sizeof(Elf64_Rela)) {
+            return bad("section " + std::to_string(i) + " has bad relocation entries");
+        }
+
+        obj.sections[sh.sh_info]->relas = (const Elf64_Rela *)(obj.data + sh.sh_offset);
+        obj.sections[sh.sh_info]->nrelas = sh.sh_size / sizeof(Elf64_Rela);
+    }
+
+    if (!symsec) {
+        return true;
+    }
+
+    if (symsec->sh_entsize != sizeof(Elf64_Sym) || symsec->sh_link >= shnum ||
+        symsec->sh_info > symsec->sh_size / sizeof(Elf64_Sym)) {
+        return bad("bad symbol table");
+    }
+
+    // names are read as C strings, the table must end with one
+    const Elf64_Shdr& strsec = obj.shdrs[symsec->sh_link];
+    if (strsec.sh_type != SHT_STRTAB || strsec.sh_size == 0 ||
+        obj.data[strsec.sh_offset + strsec.sh_size - 1] != '\0') {
+        return bad("bad symbol name table");
+    }
+
+    obj.syms = (const Elf64_Sym *)(obj.data + symsec->sh_offset);
+    obj.nsyms = symsec->sh_size / sizeof(Elf64_Sym);
+    obj.strtab = (const char *)obj.data + strsec.sh_offset;
+    obj.strsize = strsec.sh_size;
+    obj.first_global = symsec->sh_info;
+
+    obj.locals.resize(obj.first_global);
+    obj.symbols.resize(obj.nsyms);
+
+    for (uint32_t i = 0; i < obj.first_global; i++)
+    {
+        const Elf64_Sym& sym = obj.syms[i];
+        ElfSymbol& local = obj.locals[i];
+
+        if (!CheckSymbol(obj, sym, i)) {
+            return false;
+        }
+
+        local.name = obj.strtab + sym.st_name;
+        local.file = &obj;
+        local.shndx = sym.st_shndx;
+        local.value = sym.st_value;
+        local.size = sym.st_size;
+        local.bind = ELF64_ST_BIND(sym.st_info);
+        local.type = ELF64_ST_TYPE(sym.st_info);
+        obj.symbols[i] = &local;
+    }
+
+    return true;
+}
+
+// name and section index of symbol index of obj, both are used unchecked later
+bool ElfLinker::CheckSymbol(ElfObject& obj, const Elf64_Sym& sym, uint32_t index)
+{
+    std::string what = obj.name + ": symbol " + std::to_string(index);
+
+    if (sym.st_name >= obj.strsize) {
+        return Reject(what + " has a bad name");
+    }
+
+    if (sym.st_shndx == SHN_XINDEX ||
+        (IsRegularIndex(sym.st_shndx) && sym.st_shndx >= obj.sections.size())) {
+        return Reject(what + " has a bad section index " + std::to_string(sym.st_shndx));
+    }
+
+    return true;
+}
+
+/*
+ * precedence: strong definition > common > weak definition > undefined,
+ * equal ranks go to the object that comes first on the command line so the
+ * result does not depend on which thread gets there first. Two strong
+ * definitions are left to ld to report.
+ */
+bool ElfLinker::ResolveSymbols(ElfObject& obj)
+{
+    auto rank = [](const ElfSymbol *s) {
+        if (!IsDefined(s)) {
+            return 0;
+        }
+        if (s->bind == STB_WEAK) {
+            return 1;
+        }
+        return s->shndx == SHN_COMMON ? 2 : 3;
+    };
+
+    for (uint32_t i = obj.first_global; i < obj.nsyms; i++)
+    {
+        const Elf64_Sym& sym = obj.syms[i];
+        uint8_t bind = ELF64_ST_BIND(sym.st_info);
+        uint8_t type = ELF64_ST_TYPE(sym.st_info);
+
+        if (!CheckSymbol(obj, sym, i)) {
+            return false;
+        }
+
+        if (type == STT_GNU_IFUNC || type == STT_TLS || (bind != STB_GLOBAL && bind != STB_WEAK)) {
+            return Reject(obj.name + ": unsupported symbol " + (obj.strtab + sym.st_name));
+        }
+
+        std::unique_lock<std::mutex> lock;
+        ElfSymbol *g = symtab.Insert(obj.strtab + sym.st_name, lock);
+        obj.symbols[i] = g;
+
+        if (sym.st_shndx == SHN_UNDEF) {
+            if (!IsDefined(g) && bind == STB_GLOBAL) {
+                g->bind = STB_GLOBAL;
+            }
+            continue;
+        }
+
+        ElfSymbol def;
+        def.name = g->name;
+        def.file = &obj;
+        def.shndx = sym.st_shndx;
+        def.value = sym.st_value;
+        def.size = sym.st_size;
+        def.bind = bind;
+        def.type = type;
+
+        int oldrank = rank(g), newrank = rank(&def);
+        bool first = !g->file || obj.priority < g->file->priority;
+
+        if (oldrank == 3 && newrank == 3) {
+            return Reject("multiple definition of " + g->name);
+        }
+
+        if (oldrank == 2 && newrank == 2) {
+            // merge common symbols: largest size, strictest alignment
+            g->size = std::max(g->size, def.size);
+            g->value = std::max(g->value, def.value);
+            if (first) {
+                g->file = &obj;
+            }
+            continue;
+        }
+
+        if (newrank > oldrank || (newrank == oldrank && first)) {
+            *g = def;
+        }
+    }
+
+    return true;
+}
+
+bool ElfLinker::ResolveObjects(size_t from)
+{
+    std::atomic<bool> ok {true};
+
+    Parallel::For(objects.size() - from, [&](size_t i) {
+        if (!ResolveSymbols(*objects[from + i])) {
+            ok = false;
+        }
+    });
+
+    return ok;
+}
+
+/*
+ * Extract archive members until no strong undefined symbol can be resolved.
+ * Each round parses and resolves the newly needed members concurrently.
+ */
+bool ElfLinker::ResolveArchives()
+{
+    std::vector<std::string> undefs;
+    std::vector<std::pair<ElfArchive*, size_t>> members;
+
+    while (true)
+    {
+        undefs.clear();
+        members.clear();
+
+        symtab.ForEach([&undefs](ElfSymbol& sym) {
+            if (!IsDefined(&sym) && sym.bind != STB_WEAK) {
+                undefs.push_back(sym.name);
+            }
+        });
+        std::sort(undefs.begin(), undefs.end());
+
+        for (auto& name : undefs)
+        {
+            for (auto& ar : archives)
+            {
+                size_t offset = ar->index.Find(name);
+                if (offset == ArchiveIndex::npos) {
+                    continue;
+                }
+
+                if (ar->loaded.insert(offset).second) {
+                    members.emplace_back(ar.get(), offset);
+                }
+                break;
+            }
+        }
+
+        if (members.empty()) {
+            return true;
+        }
+
+        std::atomic<bool> ok {true};
+        std::vector<std::unique_ptr<ElfObject>> objs(members.size());
+
+        Parallel::For(members.size(), [&](size_t i) {
+            ElfArchive *ar = members[i].first;
+            size_t offset = members[i].second;
+
+            const uint8_t *data = ar->file->data;
+            size_t size = ar->file->size;
+
+            if (offset > size || ar_hdrsize > size - offset) {
+                ok = Reject(ar->name + ": bad member offset " + std::to_string(offset));
+                return;
+            }
+
+            const char *hdr = (const char *)data + offset;
+            size_t msize = strtoul(std::string(hdr + 48, 10).c_str(), nullptr, 10);
+
+            if (msize > size - offset - ar_hdrsize) {
+                ok = Reject(ar->name + ": member at " + std::to_string(offset) + " is truncated");
+                return;
+            }
+
+            objs[i] = NewObject(ar->name + "(" + std::to_string(offset) + ")",
+                                data + offset + ar_hdrsize, msize, nextpriority + i);
+            if (!objs[i]) {
+                ok = false;
+            }
+        });
+
+        if (!ok) {
+            return false;
+        }
+
+        size_t from = objects.size();
+        nextpriority += members.size();
+
+        for (auto& obj : objs)
+        {
+            objects.emplace_back(std::move(obj));
+        }
+
+        if (!ResolveObjects(from)) {
+            return false;
+        }
+    }
+}
+
+OutputSection* ElfLinker::GetOutputSection(const InputSection& isec)
+{
+    std::string name = isec.name;
+
+    for (auto prefix : merge_prefixes)
+    {
+        size_t len = strlen(prefix);
+        if (!name.compare(0, len, prefix) && (name.size() == len || name[len] == '.')) {
+            name = prefix;
+            break;
+        }
+    }
+
+    for (auto& out : outsecs)
+    {
+        if (out->name == name) {
+            return out.get();
+        }
+    }
+
+    outsecs.emplace_back(new OutputSection);
+    outsecs.back()->name = name;
+    outsecs.back()->type = isec.shdr->sh_type;
+
+    return outsecs.back().get();
+}
+
+void ElfLinker::Layout()
+{
+    for (auto& obj : objects)
+    {
+        for (auto& isec : obj->sections)
+        {
+            if (!isec) {
+                continue;
+            }
+
+            OutputSection *out = GetOutputSection(*isec);
+            const Elf64_Shdr *sh = isec->shdr;
+
+            // .bss merged with a .data-like section becomes zero-filled data
+            if (out->type == SHT_NOBITS && sh->sh_type != SHT_NOBITS) {
+                out->type = sh->sh_type;
+            }
+
+            out->flags |= sh->sh_flags & (SHF_ALLOC | SHF_WRITE | SHF_EXECINSTR);
+            out->align = std::max<uint64_t>(out->align, sh->sh_addralign);
+            out->size = AlignTo(out->size, sh->sh_addralign);
+            isec->out = out;
+            isec->offset = out->size;
+            out->size += sh->sh_size;
+            out->members.push_back(isec.get());
+        }
+    }
+
+    // common symbols are allocated at the end of .bss, in a stable order
+    symtab.ForEach([this](ElfSymbol& sym) {
+        if (sym.file && sym.shndx == SHN_COMMON) {
+            commons.push_back(&sym);
+        }
+    });
+
+    std::sort(commons.begin(), commons.end(), [](const ElfSymbol *a, const ElfSymbol *b) {
+        return a->file->priority != b->file->priority ?
+               a->file->priority < b->file->priority : a->name < b->name;
+    });
+
+    if (commons.empty()) {
+        return;
+    }
+
+    for (auto& out : outsecs)
+    {
+        if (out->name == ".bss") {
+            bss = out.get();
+        }
+    }
+
+    if (!bss) {
+        outsecs.emplace_back(new OutputSection);
+        bss = outsecs.back().get();
+        bss->name = ".bss";
+        bss->type = SHT_NOBITS;
+        bss->flags = SHF_ALLOC | SHF_WRITE;
+    }
+
+    for (auto sym : commons)
+    {
+        bss->align = std::max(bss->align, sym->value);
+        bss->size = AlignTo(bss->size, sym->value);
+        sym->value = bss->size;
+        bss->size += sym->size;
+    }
+}
+
+bool ElfLinker::DefineSynthetic()
+{
+    bool ok {true};
+
+    symtab.ForEach([this, &ok](ElfSymbol& g) {
+        if (IsDefined(&g)) {
+            return;
+        }
+
+        bool synthetic {false};
+
+        for (auto name : synthetic_names)
+        {
+            if (g.name == name) {
+                synthetic = true;
+                break;
+            }
+        }
+
+        // __start_SECNAME / __stop_SECNAME
+        for (auto& out : outsecs)
+        {
+            if (g.name == "__start_" + out->name || g.name == "__stop_" + out->name) {
+                synthetic = true;
+                break;
+            }
+        }
+
+        if (synthetic) {
+            g.synthetic = true;
+            g.shndx = SHN_ABS;
+            g.bind = STB_GLOBAL;
+        } else if (g.bind != STB_WEAK) {
+            // let ld report the undefined reference
+            ok = Reject("undefined reference to " + g.name);
+        }
+    });
+
+    ElfSymbol *start = symtab.Find("_start");
+    if (ok && !(start && start->file)) {
+        return Reject("_start is not defined");
+    }
+
+    return ok;
+}
+
+/*
+ * Validate relocations and collect GOT references, one object per task.
+ * GOT slots are then handed out serially in object order.
+ */
+bool ElfLinker::ScanRelocations()
+{
+    std::atomic<bool> ok {true};
+    std::atomic<bool> needgot {symtab.Find("_GLOBAL_OFFSET_TABLE_") != nullptr};
+    std::vector<std::vector<ElfSymbol*>> gotrefs(objects.size());
+
+    Parallel::For(objects.size(), [&](size_t n) {
+        ElfObject *obj = objects[n].get();
+
+        for (auto& isec : obj->sections)
+        {
+            if (!isec || !isec->nrelas) {
+                continue;
+            }
+
+            std::string where = obj->name + ": " + isec->name;
+
+            if (isec->shdr->sh_type == SHT_NOBITS) {
+                ok = Reject(where + " has relocations but no data");
+                return;
+            }
+
+            for (size_t i = 0; i < isec->nrelas; i++)
+            {
+                const Elf64_Rela& r = isec->relas[i];
+                uint32_t type = ELF64_R_TYPE(r.r_info);
+                ElfSymbol *sym = Symbol(*obj, ELF64_R_SYM(r.r_info));
+                size_t width {4};
+
+                if (!sym) {
+                    ok = Reject(where + ": relocation " + std::to_string(i) + " has a bad symbol index");
+                    return;
+                }
+
+                // symbols in sections we dropped (notes, debug info ...)
+                if (sym->file && IsRegularIndex(sym->shndx) && !sym->file->sections[sym->shndx]) {
+                    ok = Reject(where + ": relocation against " + sym->name + " in a dropped section");
+                    return;
+                }
+
+                switch (type)
+                {
+                case R_X86_64_NONE:
+                    width = 0;
+                    break;
+                case R_X86_64_64:
+                case R_X86_64_PC64:
+                case R_X86_64_SIZE64:
+                    width = 8;
+                    break;
+                case R_X86_64_GOTOFF64:
+                case R_X86_64_GOTPC64:
+                    width = 8;
+                    needgot = true;
+                    break;
+                case R_X86_64_PC32:
+                case R_X86_64_PLT32:
+                case R_X86_64_32:
+                case R_X86_64_32S:
+                case R_X86_64_SIZE32:
+                    break;
+                case R_X86_64_GOTPC32:
+                    needgot = true;
+                    break;
+                case R_X86_64_GOTPCREL:
+                case R_X86_64_GOTPCRELX:
+                case R_X86_64_REX_GOTPCRELX:
+                    needgot = true;
+                    gotrefs[n].push_back(sym);
+                    break;
+                case R_X86_64_16:
+                case R_X86_64_PC16:
+                    width = 2;
+                    break;
+                case R_X86_64_8:
+                case R_X86_64_PC8:
+                    width = 1;
+                    break;
+                default:
+                    ok = Reject(where + ": unsupported relocation type " + std::to_string(type));
+                    return;
+                }
+
+                if (width > isec->shdr->sh_size || r.r_offset > isec->shdr->sh_size - width) {
+                    ok = Reject(where + ": relocation " + std::to_string(i) + " is out of bounds");
+                    return;
+                }
+            }
+        }
+    });
+
+    if (!ok) {
+        return false;
+    }
+
+    for (auto& refs : gotrefs)
+    {
+        for (auto sym : refs)
+        {
+            if (sym->got < 0) {
+                sym->got = gotsyms.size();
+                gotsyms.push_back(sym);
+            }
+        }
+    }
+
+    if (needgot) {
+        outsecs.emplace_back(new OutputSection);
+        got = outsecs.back().get();
+        got->name = ".got";
+        got->flags = SHF_ALLOC | SHF_WRITE;
+        got->align = 8;
+        got->size = gotsyms.size() * 8;
+    }
+
+    return true;
+}
+
+void ElfLinker::AssignAddresses()
+{
+    std::stable_sort(outsecs.begin(), outsecs.end(),
+        [](const std::unique_ptr<OutputSection>& a, const std::unique_ptr<OutputSection>& b) {
+            return ClassOf(*a) < ClassOf(*b);
+        });
+
+    // only .bss-like sections at the end of the rw- segment can live without
+    // file space, anything else would overlap the section laid out after it
+    for (auto& out : outsecs)
+    {
+        if (out->type == SHT_NOBITS && ClassOf(*out) != SC_BSS) {
+            out->type = SHT_PROGBITS;
+        }
+    }
+
+    // one PT_LOAD per permission set, plus PT_GNU_STACK
+    int segments[3] {1, 0, 0};
+    for (auto& out : outsecs)
+    {
+        segments[std::min<int>(ClassOf(*out), SC_DATA)] = 1;
+    }
+    size_t nphdrs = segments[0] + segments[1] + segments[2] + 1;
+
+    uint64_t offset = sizeof(Elf64_Ehdr) + nphdrs * sizeof(Elf64_Phdr);
+    uint64_t addr = image_base + offset;
+    int curseg {SC_TEXT};
+    Elf64_Phdr phdr {};
+
+    phdr.p_type = PT_LOAD;
+    phdr.p_flags = PF_R | PF_X;
+    phdr.p_offset = 0;
+    phdr.p_vaddr = phdr.p_paddr = image_base;
+    phdr.p_align = page_size;
+
+    for (auto& out : outsecs)
+    {
+        int seg = std::min<int>(ClassOf(*out), SC_DATA);
+
+        if (seg != curseg) {
+            phdr.p_filesz = offset - phdr.p_offset;
+            phdr.p_memsz = addr - phdr.p_vaddr;
+            phdrs.push_back(phdr);
+
+            offset = AlignTo(offset, page_size);
+            addr = image_base + offset;
+            curseg = seg;
+
+            phdr.p_flags = seg == SC_RODATA ? PF_R : PF_R | PF_W;
+            phdr.p_offset = offset;
+            phdr.p_vaddr = phdr.p_paddr = addr;
+        }
+
+        if (out->type == SHT_NOBITS) {
+            addr = AlignTo(addr, out->align);
+            out->addr = addr;
+            out->offset = offset;
+            addr += out->size;
+        } else {
+            offset = AlignTo(offset, out->align);
+            addr = image_base + offset;
+            out->addr = addr;
+            out->offset = offset;
+            offset += out->size;
+            addr += out->size;
+        }
+    }
+
+    phdr.p_filesz = offset - phdr.p_offset;
+    phdr.p_memsz = addr - phdr.p_vaddr;
+    phdrs.push_back(phdr);
+
+    Elf64_Phdr stack {};
+    stack.p_type = PT_GNU_STACK;
+    stack.p_flags = PF_R | PF_W;
+    stack.p_align = 16;
+    phdrs.push_back(stack);
+
+    filesize = offset;
+
+    // final symbol addresses
+    auto address = [this](ElfSymbol& sym) {
+        if (sym.synthetic) {
+            return;
+        }
+
+        if (sym.file && IsRegularIndex(sym.shndx)) {
+            InputSection *isec = sym.file->sections[sym.shndx].get();
+            if (isec) {
+                sym.addr = isec->out->addr + isec->offset + sym.value;
+            }
+        } else if (sym.file && sym.shndx == SHN_COMMON) {
+            sym.addr = bss->addr + sym.value;
+        } else if (sym.shndx == SHN_ABS) {
+            sym.addr = sym.value;
+        }
+    };
+
+    Parallel::For(objects.size(), [&](size_t i) {
+        for (auto& sym : objects[i]->locals)
+        {
+            address(sym);
+        }
+    });
+
+    symtab.ForEach(address);
+
+    // linker defined symbols
+    uint64_t etext = phdrs[0].p_vaddr + phdrs[0].p_memsz;
+    uint64_t edata = image_base, end = image_base;
+
+    for (auto& p : phdrs)
+    {
+        if (p.p_type == PT_LOAD) {
+            edata = p.p_vaddr + p.p_filesz;
+            end = p.p_vaddr + p.p_memsz;
+        }
+    }
+
+    symtab.ForEach([&](ElfSymbol& g) {
+        if (!g.synthetic) {
+            return;
+        }
+
+        const std::string& n = g.name;
+        g.addr = image_base;
+
+        if (n == "_etext" || n == "etext" || n == "__etext") {
+            g.addr = etext;
+        } else if (n == "_edata" || n == "edata" || n == "__bss_start") {
+            g.addr = edata;
+        } else if (n == "_end" || n == "end") {
+            g.addr = end;
+        } else if (n == "_GLOBAL_OFFSET_TABLE_") {
+            g.addr = got->addr;
+        }
+
+        for (auto& out : outsecs)
+        {
+            std::string sec = out->name;
+
+            // .init_array -> __init_array_start, mysec -> __start_mysec
+            if (sec.size() > 6 && !sec.compare(sec.size() - 6, 6, "_array")) {
+                sec = "_" + sec.substr(1);
+                if (n == "_" + sec + "_start") {
+                    g.addr = out->addr;
+                } else if (n == "_" + sec + "_end") {
+                    g.addr = out->addr + out->size;
+                }
+            } else if (n == "__start_" + sec) {
+                g.addr = out->addr;
+            } else if (n == "__stop_" + sec) {
+                g.addr = out->addr + out->size;
+            }
+        }
+    });
+}
+
+/*
+ * .symtab keeps the locals of every object in command line order, followed
+ * by the globals sorted by name so the output does not depend on threading.
+ * Section symbols and symbols in dropped sections are left out.
+ */
+void ElfLinker::BuildSymbolTable()
+{
+    for (size_t i = 0; i < outsecs.size(); i++)
+    {
+        outsecs[i]->index = i + 1;
+    }
+
+    symstrtab.assign(1, '\0');
+    outsyms.assign(1, Elf64_Sym {});
+
+    auto add = [this](const ElfSymbol& sym) {
+        Elf64_Sym s {};
+
+        if (sym.synthetic) {
+            s.st_shndx = SHN_ABS;
+        } else if (sym.file && IsRegularIndex(sym.shndx)) {
+            InputSection *isec = sym.file->sections[sym.shndx].get();
+            if (!isec) {
+                return;
+            }
+            s.st_shndx = isec->out->index;
+        } else if (sym.file && sym.shndx == SHN_COMMON) {
+            s.st_shndx = bss->index;
+        } else if (sym.file || sym.shndx == SHN_ABS) {
+            s.st_shndx = SHN_ABS;
+        }
+
+        if (!sym.name.empty()) {
+            s.st_name = symstrtab.size();
+            symstrtab += sym.name;
+            symstrtab += '\0';
+        }
+
+        s.st_info = ELF64_ST_INFO(sym.bind, sym.type == STT_COMMON ? STT_OBJECT : sym.type);
+        s.st_value = s.st_shndx == SHN_UNDEF ? 0 : sym.addr;
+        s.st_size = sym.size;
+        outsyms.push_back(s);
+    };
+
+    for (auto& obj : objects)
+    {
+        for (auto& sym : obj->locals)
+        {
+            if (sym.type != STT_SECTION && !sym.name.empty()) {
+                add(sym);
+            }
+        }
+    }
+    nlocals = outsyms.size();
+
+    std::vector<ElfSymbol*> globals;
+    symtab.ForEach([&globals](ElfSymbol& g) {
+        globals.push_back(&g);
+    });
+
+    std::sort(globals.begin(), globals.end(), [](const ElfSymbol *a, const ElfSymbol *b) {
+        return a->name < b->name;
+    });
+
+    for (auto g : globals)
+    {
+        add(*g);
+    }
+
+    // symbol and section tables go after the last loaded byte
+    shstrtab.assign(1, '\0');
+    for (auto& out : outsecs)
+    {
+        shstrtab += out->name;
+        shstrtab += '\0';
+    }
+    shstrtab += ".symtab";
+    shstrtab += '\0';
+    shstrtab += ".strtab";
+    shstrtab += '\0';
+    shstrtab += ".shstrtab";
+    shstrtab += '\0';
+
+    symoff = AlignTo(filesize, 8);
+    symstroff = symoff + outsyms.size() * sizeof(Elf64_Sym);
+    stroff = symstroff + symstrtab.size();
+    shoff = AlignTo(stroff + shstrtab.size(), 8);
+    filesize = shoff + (outsecs.size() + 4) * sizeof(Elf64_Shdr);
+}
+
+ElfSymbol* ElfLinker::Symbol(ElfObject& obj, uint32_t index)
+{
+    if (index >= obj.symbols.size()) {
+        return nullptr;
+    }
+
+    return obj.symbols[index];
+}
+
+bool ElfLinker::ApplyRelocations(InputSection& isec, uint8_t *image)
+{
+    uint8_t *base = image + isec.out->offset + isec.offset;
+    uint64_t secaddr = isec.out->addr + isec.offset;
+    uint64_t gotaddr = got ? got->addr : 0;
+
+    for (size_t i = 0; i < isec.nrelas; i++)
+    {
+        const Elf64_Rela& r = isec.relas[i];
+        ElfSymbol *sym = Symbol(*isec.file, ELF64_R_SYM(r.r_info));
+        uint8_t *loc = base + r.r_offset;
+        uint64_t S = sym->addr;
+        int64_t A = r.r_addend;
+        uint64_t P = secaddr + r.r_offset;
+        uint64_t v64;
+        int64_t sv;
+
+        switch (ELF64_R_TYPE(r.r_info))
+        {
+        case R_X86_64_NONE:
+            continue;
+        case R_X86_64_64:
+            v64 = S + A;
+            memcpy(loc, &v64, 8);
+            continue;
+        case R_X86_64_PC64:
+            v64 = S + A - P;
+            memcpy(loc, &v64, 8);
+            continue;
+        case R_X86_64_SIZE64:
+            v64 = sym->size + A;
+            memcpy(loc, &v64, 8);
+            continue;
+        case R_X86_64_GOTOFF64:
+            v64 = S + A - gotaddr;
+            memcpy(loc, &v64, 8);
+            continue;
+        case R_X86_64_GOTPC64:
+            v64 = gotaddr + A - P;
+            memcpy(loc, &v64, 8);
+            continue;
+        case R_X86_64_32:
+            v64 = S + A;
+            if (v64 >> 32) {
+                return false;
+            }
+            memcpy(loc, &v64, 4);
+            continue;
+        case R_X86_64_SIZE32:
+            v64 = sym->size + A;
+            if (v64 >> 32) {
+                return false;
+            }
+            memcpy(loc, &v64, 4);
+            continue;
+        case R_X86_64_32S:
+            sv = S + A;
+            break;
+        case R_X86_64_PC32:
+        case R_X86_64_PLT32:
+            sv = S + A - P;
+            break;
+        case R_X86_64_GOTPC32:
+            sv = gotaddr + A - P;
+            break;
+        case R_X86_64_GOTPCREL:
+        case R_X86_64_GOTPCRELX:
+        case R_X86_64_REX_GOTPCRELX:
+            sv = gotaddr + sym->got * 8 + A - P;
+            break;
+        case R_X86_64_16:
+        case R_X86_64_PC16:
+            sv = S + A - (ELF64_R_TYPE(r.r_info) == R_X86_64_PC16 ? P : 0);
+            if (sv < INT16_MIN || sv > UINT16_MAX) {
+                return false;
+            }
+            memcpy(loc, &sv, 2);
+            continue;
+        case R_X86_64_8:
+        case R_X86_64_PC8:
+            sv = S + A - (ELF64_R_TYPE(r.r_info) == R_X86_64_PC8 ? P : 0);
+            if (sv < INT8_MIN || sv > UINT8_MAX) {
+                return false;
+            }
+            memcpy(loc, &sv, 1);
+            continue;
+        default:
+            return false;
+        }
+
+        // signed 32-bit fields
+        if (sv < INT32_MIN || sv > INT32_MAX) {
+            return false;
+        }
+        memcpy(loc, &sv, 4);
+    }
+
+    return true;
+}
+
+bool ElfLinker::Write(const std::string& output)
+{
+    std::vector<uint8_t> image(filesize);
+
+    // ELF header and program headers
+    Elf64_Ehdr ehdr {};
+    memcpy(ehdr.e_ident, ELFMAG, SELFMAG);
+    ehdr.e_ident[EI_CLASS] = ELFCLASS64;
+    ehdr.e_ident[EI_DATA] = ELFDATA2LSB;
+    ehdr.e_ident[EI_VERSION] = EV_CURRENT;
+    ehdr.e_ident[EI_OSABI] = ELFOSABI_SYSV;
+    ehdr.e_type = ET_EXEC;
+    ehdr.e_machine = EM_X86_64;
+    ehdr.e_version = EV_CURRENT;
+    ehdr.e_entry = symtab.Find("_start")->addr;
+    ehdr.e_phoff = sizeof(Elf64_Ehdr);
+    ehdr.e_shoff = shoff;
+    ehdr.e_ehsize = sizeof(Elf64_Ehdr);
+    ehdr.e_phentsize = sizeof(Elf64_Phdr);
+    ehdr.e_phnum = phdrs.size();
+    ehdr.e_shentsize = sizeof(Elf64_Shdr);
+    ehdr.e_shnum = outsecs.size() + 4;
+    ehdr.e_shstrndx = outsecs.size() + 3;
+
+    memcpy(image.data(), &ehdr, sizeof(ehdr));
+    memcpy(image.data() + sizeof(ehdr), phdrs.data(), phdrs.size() * sizeof(Elf64_Phdr));
+
+    for (size_t i = 0; i < gotsyms.size(); i++)
+    {
+        memcpy(image.data() + got->offset + i * 8, &gotsyms[i]->addr, 8);
+    }
+
+    // copy and relocate input sections, they never overlap in the image
+    std::vector<InputSection*> isecs;
+    for (auto& out : outsecs)
+    {
+        isecs.insert(isecs.end(), out->members.begin(), out->members.end());
+    }
+
+    const size_t chunk {32};
+    std::atomic<bool> ok {true};
+
+    Parallel::For((isecs.size() + chunk - 1) / chunk, [&](size_t n) {
+        size_t end = std::min(isecs.size(), (n + 1) * chunk);
+
+        for (size_t i = n * chunk; i < end; i++)
+        {
+            InputSection *isec = isecs[i];
+            const Elf64_Shdr *sh = isec->shdr;
+
+            if (sh->sh_type == SHT_NOBITS) {
+                continue;
+            }
+
+            memcpy(image.data() + isec->out->offset + isec->offset,
+                   isec->file->data + sh->sh_offset, sh->sh_size);
+
+            if (!ApplyRelocations(*isec, image.data())) {
+                ok = Reject(isec->file->name + ": " + isec->name + ": relocation out of range");
+            }
+        }
+    });
+
+    if (!ok) {
+        return false;
+    }
+
+    // symbol table and section headers
+    memcpy(image.data() + symoff, outsyms.data(), outsyms.size() * sizeof(Elf64_Sym));
+    memcpy(image.data() + symstroff, symstrtab.data(), symstrtab.size());
+    memcpy(image.data() + stroff, shstrtab.data(), shstrtab.size());
+
+    size_t nsecs = outsecs.size();
+    std::vector<Elf64_Shdr> shdrs(nsecs + 4);
+    uint32_t name {1};
+
+    for (size_t i = 0; i < nsecs; i++)
+    {
+        Elf64_Shdr& sh = shdrs[i + 1];
+        OutputSection *out = outsecs[i].get();
+
+        sh.sh_name = name;
+        sh.sh_type = out->type;
+        sh.sh_flags = out->flags;
+        sh.sh_addr = out->addr;
+        sh.sh_offset = out->offset;
+        sh.sh_size = out->size;
+        sh.sh_addralign = out->align;
+        name += out->name.size() + 1;
+    }
+
+    Elf64_Shdr& symsh = shdrs[nsecs + 1];
+    symsh.sh_name = name;
+    symsh.sh_type = SHT_SYMTAB;
+    symsh.sh_offset = symoff;
+    symsh.sh_size = outsyms.size() * sizeof(Elf64_Sym);
+    symsh.sh_link = nsecs + 2;
+    symsh.sh_info = nlocals;
+    symsh.sh_addralign = 8;
+    symsh.sh_entsize = sizeof(Elf64_Sym);
+    name += sizeof(".symtab");
+
+    Elf64_Shdr& symstrsh = shdrs[nsecs + 2];
+    symstrsh.sh_name = name;
+    symstrsh.sh_type = SHT_STRTAB;
+    symstrsh.sh_offset = symstroff;
+    symstrsh.sh_size = symstrtab.size();
+    symstrsh.sh_addralign = 1;
+    name += sizeof(".strtab");
+
+    Elf64_Shdr& strsh = shdrs[nsecs + 3];
+    strsh.sh_name = name;
+    strsh.sh_type = SHT_STRTAB;
+    strsh.sh_offset = stroff;
+    strsh.sh_size = shstrtab.size();
+    strsh.sh_addralign = 1;
+
+    memcpy(image.data() + shoff, shdrs.data(), shdrs.size() * sizeof(Elf64_Shdr));
+
+    // replace, don't rewrite in place: the old binary may still be running
+    unlink(output.c_str());
+
+    int fd = open(output.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0777);
+    if (fd < 0) {
+        return Reject(output + ": can not be written");
+    }
+
+    const uint8_t *p = image.data();
+    size_t left = image.size();
+
+    while (left > 0)
+    {
+        ssize_t n = write(fd, p, left);
+        if (n <= 0) {
+            close(fd);
+            unlink(output.c_str());
+            return Reject(output + ": can not be written");
+        }
+        p += n;
+        left -= n;
+    }
+
+    if (close(fd) != 0) {
+        return Reject(output + ": can not be written");
+    }
+
+    return true;
+}
+
+}
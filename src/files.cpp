@@ -1,5 +1,11 @@
 #include <map>
+#include <cerrno>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+
+#include <sys/stat.h>
 
 #include "files.h"
 
@@ -12,6 +18,7 @@ static std::map<FileType, const char *> filemap {
     {OBJ_FILE, ".o"},
     {DSO_FILE, ".so"},
     {PREC_FILE,".i"},
+    {TOK_FILE, ".tok"},
 };
 
 std::string Files::DirName(const std::string& name)
@@ -49,6 +56,46 @@ std::string Files::BaseName(const std::string& name)
     return name;
 }
 
+bool Files::ReadFile(const std::string& name, std::string& content)
+{
+    struct stat st;
+
+    // the end of a directory is seekable on some filesystems, at 2^63-1
+    if (stat(name.c_str(), &st) || !S_ISREG(st.st_mode)) {
+        return false;
+    }
+
+    std::ifstream ifs(name, std::ios::in | std::ios::binary);
+    if (!ifs.is_open()) {
+        return false;
+    }
+
+    ifs.seekg(0, std::ios::end);
+    std::streamoff size = ifs.tellg();
+    if (size < 0) {
+        return false;
+    }
+
+    content.resize(size);
+    ifs.seekg(0, std::ios::beg);
+    ifs.read(&content[0], content.size());
+
+    return (bool)ifs;
+}
+
+bool Files::WriteFile(const std::string& name, const std::string& content)
+{
+    std::ofstream ofs(name, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!ofs.is_open()) {
+        return false;
+    }
+
+    ofs.write(content.data(), content.size());
+    ofs.close();
+
+    return !ofs.fail();
+}
+
 void Files::RenameFile(const std::string& oldpath, const std::string& newpath)
 {
     rename(oldpath.c_str(), newpath.c_str());
@@ -58,7 +105,8 @@ FileType Files::GetFileType(const std::string& name)
 {
     for (auto& pair : filemap)
     {
-        if (name.substr(name.size() - 2) == pair.second) {
+        size_t len = strlen(pair.second);
+        if (name.size() >= len && !name.compare(name.size() - len, len, pair.second)) {
             return pair.first;
         }
     }
@@ -76,6 +124,32 @@ std::string Files::ConvertTo(const std::string& name, FileType type)
     return std::string(name).replace(pos, name.size() - pos, filemap[type]);
 }
 
+// $XDG_CACHE_HOME/c-- or $HOME/.cache/c--, empty if unusable
+std::string Files::CacheDir()
+{
+    const char *env;
+    std::string dir;
+
+    if ((env = getenv("XDG_CACHE_HOME")) && *env) {
+        dir = env;
+    } else if ((env = getenv("HOME")) && *env) {
+        dir = std::string(env) + "/.cache";
+    } else {
+        return "";
+    }
+
+    if (mkdir(dir.c_str(), 0755) && errno != EEXIST) {
+        return "";
+    }
+
+    dir += "/c--";
+    if (mkdir(dir.c_str(), 0755) && errno != EEXIST) {
+        return "";
+    }
+
+    return dir;
+}
+
 void Files::DispatchFiles(const CcArg& ccarg)
 {
     // dispatch input files
@@ -96,6 +170,9 @@ void Files::DispatchFiles(const CcArg& ccarg)
             case FileType::ASM_FILE:
                 asmfiles.emplace_back(s);
                 break;
+            case FileType::TOK_FILE:
+                tokfiles.emplace_back(s);
+                break;
             case FileType::AR_FILE:
             case FileType::DSO_FILE:
             case FileType::OBJ_FILE:
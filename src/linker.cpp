@@ -1,14 +1,16 @@
 #include <vector>
 #include <string>
 
-#include <glob.h>
 #include <unistd.h>
 #include <sys/stat.h>
-#include <sys/wait.h>
 #include <sys/types.h>
 
 #include "log.h"
 #include "linker.h"
+#include "profile.h"
+#include "process.h"
+#include "toolchain.h"
+#include "elflinker.h"
 
 namespace c89 {
 
@@ -22,30 +24,39 @@ void Linker::Link(const CcArg& arg, Files& files)
         return;
     }
 
+    if (arg.opt_builtin_ld && LinkBuiltin(arg, files)) {
+        return;
+    }
+
     cmds.emplace_back("ld");
     cmds.emplace_back("-o");
     cmds.emplace_back(arg.output);
     cmds.emplace_back("-m");
     cmds.emplace_back("elf_x86_64");
 
-    auto glibctr = FindGlibCrt();
-    auto gcclibctr = FindGccLibCrt();
+    if (!arg.opt_nostdlib) {
+        const Toolchain& tc = Toolchain::Probe();
+        const auto& glibctr = tc.glibcrt;
+        const auto& gcclibctr = tc.gcclibcrt;
+
+        if (arg.opt_shared) {
+            cmds.emplace_back(glibctr + "/crti.o");
+            cmds.emplace_back(gcclibctr + "/crtbeginS.o");
+        } else {
+            cmds.emplace_back(glibctr + "/crti.o");
+            cmds.emplace_back(glibctr + "/crt1.o");
+            cmds.emplace_back(gcclibctr + "/crtbegin.o");
+        }
 
-    if (arg.opt_shared) {
-        cmds.emplace_back(glibctr + "/crti.o");
-        cmds.emplace_back(gcclibctr + "/crtbeginS.o");
-    } else {
-        cmds.emplace_back(glibctr + "/crti.o");
-        cmds.emplace_back(glibctr + "/crt1.o");
-        cmds.emplace_back(gcclibctr + "/crtbegin.o");
+        cmds.emplace_back("-L /usr/lib");
+        cmds.emplace_back("-L /usr/lib64");
+        cmds.emplace_back("-L" + glibctr);
+        cmds.emplace_back("-L" + gcclibctr);
     }
 
-    cmds.emplace_back("-L /usr/lib");
-    cmds.emplace_back("-L /usr/lib64");
-    cmds.emplace_back("-L" + glibctr);
-    cmds.emplace_back("-L" + gcclibctr);
-
-    if (!arg.opt_static) {
+    if (arg.opt_static) {
+        cmds.emplace_back("-static");
+    } else {
         cmds.emplace_back("-dynamic-linker");
         cmds.emplace_back("/lib64/ld-linux-x86-64.so.2");
     }
@@ -54,106 +65,125 @@ void Linker::Link(const CcArg& arg, Files& files)
     cmds.insert(cmds.end(), files.tmpobjfiles.begin(), files.tmpobjfiles.end());
     cmds.insert(cmds.end(), arg.ldargs.begin(), arg.ldargs.end());
 
-    if (arg.opt_static) {
-        cmds.emplace_back("--start-group");
-        cmds.emplace_back("-lgcc");
-        cmds.emplace_back("-lgcc_eh");
-        cmds.emplace_back("-lc");
-        cmds.emplace_back("--end-group");
-    } else {
-        cmds.emplace_back("-lc");
-        cmds.emplace_back("-lgcc");
-        cmds.emplace_back("--as-needed");
-        cmds.emplace_back("-lgcc_s");
-        cmds.emplace_back("--no-as-needed");
-    }
+    if (!arg.opt_nostdlib) {
+        const Toolchain& tc = Toolchain::Probe();
+
+        if (arg.opt_static) {
+            cmds.emplace_back("--start-group");
+            cmds.emplace_back("-lgcc");
+            cmds.emplace_back("-lgcc_eh");
+            cmds.emplace_back("-lc");
+            cmds.emplace_back("--end-group");
+        } else {
+            cmds.emplace_back("-lc");
+            cmds.emplace_back("-lgcc");
+            cmds.emplace_back("--as-needed");
+            cmds.emplace_back("-lgcc_s");
+            cmds.emplace_back("--no-as-needed");
+        }
 
-    if (arg.opt_shared) {
-        cmds.emplace_back(gcclibctr + "/crtendS.o");
-    } else {
-        cmds.emplace_back(gcclibctr + "/crtend.o");
+        if (arg.opt_shared) {
+            cmds.emplace_back(tc.gcclibcrt + "/crtendS.o");
+        } else {
+            cmds.emplace_back(tc.gcclibcrt + "/crtend.o");
+        }
+        cmds.emplace_back(tc.glibcrt + "/crtn.o");
     }
-    cmds.emplace_back(glibctr + "/crtn.o");
 
     // run ld command
     for (auto& s:cmds)
         ccmds.emplace_back(s.c_str());
     ccmds.emplace_back(nullptr);
 
-    if (fork() == 0) {
-        execvp(ccmds[0], (char *const*)ccmds.data());
-        exit(1);
-    }
+    ScopedTimer t("ld");
 
-    wait(nullptr);
+    if (Process::Run(ccmds) != 0) {
+        Error::Fatal("ld returned an error");
+    }
 }
 
-std::string Linker::FindGlibCrt()
+/*
+ * Link static executables in process. Only static archives and relocatable
+ * objects are accepted, anything else returns false and ld is used instead.
+ * glibc's libc.a always needs TLS and IFUNC, which ElfLinker does not
+ * implement, so links against the default libraries go to ld right away
+ * instead of parsing every archive first.
+ */
+bool Linker::LinkBuiltin(const CcArg& arg, const Files& files)
 {
-    struct stat st;
+    std::vector<std::string> inputs, libdirs, libs;
 
-    if (!stat("/usr/lib/x86_64-linux-gnu/crti.o", &st)) {
-        return "/usr/lib/x86_64-linux-gnu";
+    if (arg.opt_shared || !arg.opt_nostdlib) {
+        return false;
     }
 
-    if (!stat("/usr/lib64/crti.o", &st)) {
-        return "/usr/lib64";
+    // -L may follow -l on the command line, collect search dirs first
+    for (size_t i = 0; i < arg.ldargs.size(); i++)
+    {
+        const std::string& s = arg.ldargs[i];
+        auto value = s.substr(2, s.npos);
+        value.erase(0, value.find_first_not_of(' '));
+
+        if (!s.compare(0, 2, "-L")) {
+            libdirs.push_back(value);
+        } else if (!s.compare(0, 2, "-l")) {
+            libs.push_back(value);
+        } else {
+            return false;
+        }
     }
 
-    Error::Fatal("Glibc Runtime Library not found");
-    return "";
-}
-
-std::string Linker::FindGccLibCrt()
-{
-    unsigned int v;
-    glob_t buf;
-    std::string version, path;
+    libdirs.emplace_back("/usr/lib");
+    libdirs.emplace_back("/usr/lib64");
 
-    if ((v = GetGccVersion())) {
-        version = std::to_string(v);
-    } else {
-        version = "*";
+    for (auto& f : files.objfiles)
+    {
+        if (Files::GetFileType(f) == DSO_FILE) {
+            return false;
+        }
+        inputs.push_back(f);
     }
+    inputs.insert(inputs.end(), files.tmpobjfiles.begin(), files.tmpobjfiles.end());
 
-    std::vector<std::string> paths {
-        "/usr/lib/gcc/x86_64*/" + version + "/crtbegin.o",
-        "/usr/lib64/gcc/x86_64*/" + version + "/crtbegin.o",
-    };
-
-    for (auto& s : paths)
+    for (auto& l : libs)
     {
-        glob(s.c_str(), 0, NULL, &buf);
-        if (buf.gl_pathc > 0) {
-            path = buf.gl_pathv[buf.gl_pathc - 1];
-            globfree(&buf);
-            return Files::DirName(path);
+        std::string path = FindLibrary(l, libdirs, arg.opt_static);
+        if (path.empty()) {
+            return false;
         }
+        inputs.push_back(path);
     }
 
-    Error::Fatal("Gcc Runtime Library not found");
-    return "";
+    ScopedTimer t("builtin ld");
+    std::string why;
+
+    if (!ElfLinker::Link(arg.output, inputs, &why)) {
+        Error::Warning("builtin linker: " + why + ", using ld");
+        return false;
+    }
+
+    return true;
 }
 
-unsigned int Linker::GetGccVersion()
+// libname.a, empty if not found or if only a shared libname.so is usable
+std::string Linker::FindLibrary(const std::string& name,
+                                const std::vector<std::string>& dirs, bool isstatic)
 {
-    int n;
-    FILE *fp;
-    unsigned int version;
+    struct stat st;
 
-    fp = popen("gcc -dumpversion", "r");
-    if (!fp) {
-        return 0;
-    }
+    for (auto& dir : dirs)
+    {
+        if (!isstatic && !stat((dir + "/lib" + name + ".so").c_str(), &st)) {
+            return "";
+        }
 
-    n = fscanf(fp, "%u", &version);
-    if (n != 1) {
-        return 0;
+        std::string path = dir + "/lib" + name + ".a";
+        if (!stat(path.c_str(), &st)) {
+            return path;
+        }
     }
 
-    fclose(fp);
-
-    return version;
+    return "";
 }
 
-}
\ No newline at end of file
+}
@@ -1,11 +1,34 @@
 #include <vector>
 #include <string>
 
+#include <memory>
+
+#include "log.h"
 #include "files.h"
 #include "linker.h"
 #include "argument.h"
 #include "assemble.h"
+#include "remote.h"
+#include "profile.h"
+#include "pipeline.h"
 #include "tokenize.h"
+#include "tokenfile.h"
+
+namespace {
+
+struct Unit
+{
+    Unit(const std::string& file, c89::FileType type) : file(file), type(type) {}
+
+    std::string file;
+    c89::FileType type;
+    std::string content;
+    std::unique_ptr<c89::Tokenizer> toks;
+    std::string objfile;
+    std::string error;      // reported by the emit stage, stages run on any thread
+};
+
+}
 
 int main(int argc, char **argv)
 {
@@ -16,23 +39,149 @@ int main(int argc, char **argv)
     c89::CcArg ccarg;
     ccarg.ParseArgs(argc, argv);
 
+    c89::Profiler::Enable(ccarg.opt_time_report, ccarg.tracefile);
+
+    // c-- --worker [host:]port [--worker-allow addr[/bits],...]
+    if (ccarg.opt_worker) {
+        return c89::Worker::Listen(ccarg.workeraddr, ccarg.workerallow);
+    }
+
     // dispatch input files
-    files.DispatchFiles(ccarg);
+    {
+        c89::ScopedTimer t("dispatch");
+        files.DispatchFiles(ccarg);
+    }
+
+    // every input file is a translation unit flowing through the stages,
+    // different units are in different stages at the same time
+    std::vector<Unit> units;
+    for (const auto& vec : {files.cfiles, files.tmpcfiles})
+    {
+        for (const auto& s : vec)
+        {
+            units.emplace_back(s, c89::C_FILE);
+        }
+    }
+    for (const auto& s : files.tokfiles)
+    {
+        units.emplace_back(s, c89::TOK_FILE);
+    }
+    for (const auto& vec : {files.asmfiles, files.tmpasmfiles})
+    {
+        for (const auto& s : vec)
+        {
+            units.emplace_back(s, c89::ASM_FILE);
+        }
+    }
+
+    c89::Pipeline pipeline;
 
     // preprocess 生成 .i 即 tmpcfiles, 临时c文件
     // 先不写预处理，先写 tokenize和codegen, 最后写预处理
+    pipeline.AddStage("preprocess", [&](size_t i) {
+        Unit& u = units[i];
+        if (u.type == c89::C_FILE && !c89::Files::ReadFile(u.file, u.content)) {
+            u.error = "File "+u.file+" not found or not readable";
+        }
+
+        // already lexed
+        if (u.type == c89::TOK_FILE) {
+            c89::TokenFile tf;
+            if (!tf.Open(u.file)) {
+                u.error = "File "+u.file+" is not a token file of this version";
+                return;
+            }
+            u.toks.reset(new c89::Tokenizer);
+            u.toks->Load(tf);
+            u.content = tf.Source();
+        }
+    });
 
     // lexical
-    c89::Tokenizer toks;
-    toks.TokenizeFiles(ccarg, files);
+    pipeline.AddStage("lex", [&](size_t i) {
+        Unit& u = units[i];
+        if (u.type == c89::C_FILE && u.error.empty()) {
+            u.toks.reset(new c89::Tokenizer);
+            u.toks->Tokenize(ccarg, u.file, u.content);
+
+            // c-- xxx.c -emit-tokens
+            if (ccarg.opt_emit_tokens && u.toks->diags.Count() == 0) {
+                auto tokfile = c89::Files::BaseName(c89::Files::ConvertTo(u.file, c89::TOK_FILE));
+                if (!c89::TokenFile::Write(tokfile, u.toks->tokenlist, u.content)) {
+                    u.error = "can not write "+tokfile;
+                }
+            }
+
+            // diagnostics and the token dump quote the source
+            if (u.toks->diags.Count() == 0 && !ccarg.opt_dump_tokens) {
+                u.content.clear();
+            }
+        }
+    });
 
     // parse
 
-    // codegen
+    // codegen, streams its output to as through c89::AsmPipe
+
+    pipeline.AddStage("assemble", [&](size_t i) {
+        Unit& u = units[i];
+        if (u.type == c89::ASM_FILE && !ccarg.opt_dump_tokens) {
+            // on a worker if one is idle, else here
+            auto remote = c89::Scheduler::Get(ccarg);
+            u.objfile = c89::Files::BaseName(c89::Files::ConvertTo(u.file, c89::OBJ_FILE));
+            if ((!remote || !remote->Assemble(u.file, u.objfile)) &&
+                !c89::Assembler::AssembleFile(u.file, u.objfile)) {
+                u.error = "as returned an error for '" + u.file + "'";
+                u.objfile.clear();
+            }
+        }
+    });
+
+    // in command line order
+    bool errors = false;
+    pipeline.AddSerialStage("emit", [&](size_t i) {
+        Unit& u = units[i];
+        if (!u.error.empty()) {
+            c89::Error::Report(u.error);
+            errors = true;
+        } else if (u.toks && u.toks->diags.Count()) {
+            u.toks->diags.Report(u.file, u.content);
+            errors = true;
+        } else if (u.toks && ccarg.opt_dump_tokens) {
+            u.toks->Dump(u.content);
+        }
+        u.toks.reset();
+        u.content.clear();
+        if (!u.objfile.empty()) {
+            files.tmpobjfiles.emplace_back(u.objfile);
+        }
+    });
+
+    {
+        c89::ScopedTimer t("compile");
+        pipeline.Run(units.size());
+    }
+
+    if (errors) {
+        return 1;
+    }
+
+    // c-- xxx -dump-tokens
+    if (ccarg.opt_dump_tokens) {
+        return 0;
+    }
+
+    c89::Assembler::Finish(ccarg, files);
 
-    c89::Assembler::Assemble(ccarg, files);
+    // c-- xxx -c
+    if (ccarg.opt_c) {
+        return 0;
+    }
 
-    c89::Linker::Link(ccarg, files);
+    {
+        c89::ScopedTimer t("link");
+        c89::Linker::Link(ccarg, files);
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "mappedfile.h"
+
+namespace c89 {
+
+MappedFile::~MappedFile()
+{
+    if (data) {
+        munmap((void *)data, size);
+    }
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+    int fd;
+    void *addr;
+
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    if (fstat(fd, &st) || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+
+    data = (const uint8_t *)addr;
+    size = st.st_size;
+
+    return true;
+}
+
+}
@@ -0,0 +1,56 @@
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+#include "parallel.h"
+
+namespace c89 {
+
+static std::atomic<unsigned int> nthreads_set {0};
+
+unsigned int Parallel::Threads()
+{
+    static unsigned int n = std::max(1u, std::thread::hardware_concurrency());
+    unsigned int set = nthreads_set.load(std::memory_order_relaxed);
+    return set ? set : n;
+}
+
+void Parallel::SetThreads(unsigned int n)
+{
+    nthreads_set.store(n, std::memory_order_relaxed);
+}
+
+void Parallel::For(size_t n, const std::function<void(size_t)>& fn)
+{
+    std::atomic<size_t> next {0};
+    std::vector<std::thread> workers;
+    size_t nthreads = std::min<size_t>(Threads(), n);
+
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next.fetch_add(1, std::memory_order_relaxed)) < n)
+        {
+            fn(i);
+        }
+    };
+
+    if (nthreads <= 1) {
+        worker();
+        return;
+    }
+
+    // the calling thread is one of the workers
+    for (size_t i = 1; i < nthreads; i++)
+    {
+        workers.emplace_back(worker);
+    }
+    worker();
+
+    for (auto& t : workers)
+    {
+        t.join();
+    }
+}
+
+}
@@ -0,0 +1,194 @@
+#include <thread>
+#include <algorithm>
+
+#include "profile.h"
+#include "parallel.h"
+#include "pipeline.h"
+
+namespace c89 {
+
+void Pipeline::AddStage(const char *name, const Stage& fn)
+{
+    stages.emplace_back();
+    stages.back().name = name;
+    stages.back().fn = fn;
+    stages.back().serial = false;
+}
+
+void Pipeline::AddSerialStage(const char *name, const Stage& fn)
+{
+    stages.emplace_back();
+    stages.back().name = name;
+    stages.back().fn = fn;
+    stages.back().serial = true;
+}
+
+size_t Pipeline::Capacity()
+{
+    return 2 * Parallel::Threads();
+}
+
+void Pipeline::Run(size_t n)
+{
+    std::vector<std::thread> threads;
+    size_t nworkers = std::max<size_t>(1, std::min<size_t>(Parallel::Threads(), n));
+
+    nitems = n;
+    admitted = 0;
+    finished = 0;
+    queued = 0;
+    workers.resize(nworkers);
+
+    // a pipeline may be run more than once
+    for (auto& stage : stages)
+    {
+        stage.ready.clear();
+        stage.next = 0;
+        stage.busy = false;
+    }
+
+    if (n == 0) {
+        return;
+    }
+
+    // seed the pipeline, later items are admitted as earlier ones finish
+    for (size_t i = 0; i < std::min(n, Capacity()); i++)
+    {
+        Forward(i % nworkers, admitted++, 0);
+    }
+
+    // the calling thread is worker 0
+    for (size_t i = 1; i < nworkers; i++)
+    {
+        threads.emplace_back(&Pipeline::Loop, this, i);
+    }
+    Loop(0);
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+}
+
+void Pipeline::Loop(size_t self)
+{
+    Task task;
+
+    while (true)
+    {
+        if (Take(self, task)) {
+            Execute(stages[task.stage], task.item);
+            Forward(self, task.item, task.stage + 1);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(idlelock);
+        idle.wait(lock, [this]() { return queued > 0 || finished == nitems; });
+
+        if (queued == 0 && finished == nitems) {
+            return;
+        }
+    }
+}
+
+// own tasks newest first, then the oldest task of another worker
+bool Pipeline::Take(size_t self, Task& task)
+{
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        Worker& w = workers[(self + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(w.lock);
+
+        if (w.tasks.empty()) {
+            continue;
+        }
+
+        if (i == 0) {
+            task = w.tasks.back();
+            w.tasks.pop_back();
+        } else {
+            task = w.tasks.front();
+            w.tasks.pop_front();
+        }
+
+        queued--;
+        return true;
+    }
+
+    return false;
+}
+
+void Pipeline::Push(size_t self, const Task& task)
+{
+    {
+        std::lock_guard<std::mutex> lock(workers[self].lock);
+        workers[self].tasks.push_back(task);
+        queued++;
+    }
+
+    std::lock_guard<std::mutex> lock(idlelock);
+    idle.notify_one();
+}
+
+void Pipeline::Forward(size_t self, size_t item, size_t stage)
+{
+    if (stage < stages.size()) {
+        if (stages[stage].serial) {
+            Drain(self, stage, item);
+        } else {
+            Push(self, Task{item, stage});
+        }
+        return;
+    }
+
+    // item left the last stage, let the next one in
+    size_t next = admitted++;
+    if (next < nitems) {
+        Forward(self, next, 0);
+    }
+
+    if (++finished == nitems) {
+        std::lock_guard<std::mutex> lock(idlelock);
+        idle.notify_all();
+    }
+}
+
+// run every item of a serial stage that is next in order; whoever finds
+// the stage idle runs it, the others only queue their item
+void Pipeline::Drain(size_t self, size_t index, size_t item)
+{
+    StageInfo& stage = stages[index];
+    std::unique_lock<std::mutex> lock(stage.lock);
+
+    stage.ready.insert(item);
+    if (stage.busy) {
+        return;
+    }
+    stage.busy = true;
+
+    while (!stage.ready.empty() && *stage.ready.begin() == stage.next)
+    {
+        item = *stage.ready.begin();
+        stage.ready.erase(stage.ready.begin());
+
+        lock.unlock();
+        Execute(stage, item);
+        lock.lock();
+
+        stage.next++;
+
+        lock.unlock();
+        Forward(self, item, index + 1);
+        lock.lock();
+    }
+
+    stage.busy = false;
+}
+
+void Pipeline::Execute(StageInfo& stage, size_t item)
+{
+    ScopedTimer t(stage.name);
+    stage.fn(item);
+}
+
+}
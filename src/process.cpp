@@ -0,0 +1,193 @@
+#include <cerrno>
+#include <cstdint>
+
+#include <spawn.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#include "profile.h"
+#include "process.h"
+
+extern char **environ;
+
+namespace c89 {
+
+pid_t Process::Spawn(const std::vector<const char*>& argv, int *stdinfd, bool quiet)
+{
+    int fds[2];
+    pid_t pid;
+    posix_spawn_file_actions_t actions;
+
+    posix_spawn_file_actions_init(&actions);
+
+    if (stdinfd) {
+        *stdinfd = -1;
+
+        if (pipe2(fds, O_CLOEXEC)) {
+            posix_spawn_file_actions_destroy(&actions);
+            return -1;
+        }
+
+        // dup2 clears O_CLOEXEC on the child's stdin
+        posix_spawn_file_actions_adddup2(&actions, fds[0], STDIN_FILENO);
+    }
+
+    if (quiet) {
+        posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    }
+
+    int err = posix_spawnp(&pid, argv[0], &actions, nullptr,
+                           (char *const*)argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+
+    if (stdinfd) {
+        close(fds[0]);
+
+        if (err) {
+            close(fds[1]);
+        } else {
+            *stdinfd = fds[1];
+        }
+    }
+
+    if (err) {
+        errno = err;
+        return -1;
+    }
+
+    Profiler::children++;
+
+    return pid;
+}
+
+int Process::Wait(pid_t pid)
+{
+    int status;
+
+    while (waitpid(pid, &status, 0) < 0)
+    {
+        if (errno != EINTR) {
+            return -1;
+        }
+    }
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int Process::Run(const std::vector<const char*>& argv)
+{
+    uint64_t start = Profiler::Now();
+    pid_t pid = Spawn(argv);
+
+    if (pid < 0) {
+        return -1;
+    }
+
+    int status = Wait(pid);
+
+    Profiler::childtime += Profiler::Now() - start;
+
+    return status;
+}
+
+AsmPipe::~AsmPipe()
+{
+    if (m_pid > 0) {
+        Close();
+    }
+}
+
+bool AsmPipe::Open(const std::string& objfile, bool quiet)
+{
+    std::vector<const char*> cmds {"as", "-o", objfile.c_str(), "-", nullptr};
+
+    m_start = Profiler::Now();
+    m_pid = Process::Spawn(cmds, &m_fd, quiet);
+    m_failed = m_pid < 0;
+    m_buf.reserve(1 << 16);
+
+    return !m_failed;
+}
+
+void AsmPipe::Write(const char *data, size_t len)
+{
+    m_buf.append(data, len);
+
+    if (m_buf.size() >= (1 << 16)) {
+        Flush();
+    }
+}
+
+/*
+ * as may exit before reading all of its input (.abort, .end, a crash).
+ * SIGPIPE is blocked in this thread while writing so that only the write
+ * fails, a SIGPIPE left pending by it is consumed before unblocking.
+ */
+void AsmPipe::Flush()
+{
+    const char *p = m_buf.data();
+    size_t left = m_buf.size();
+
+    if (left == 0 || m_fd < 0) {
+        m_buf.clear();
+        return;
+    }
+
+    sigset_t sigpipe, old;
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe, &old);
+
+    while (left > 0)
+    {
+        ssize_t n = write(m_fd, p, left);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+
+        // as is gone, Close() reports it
+        if (n <= 0) {
+            if (n < 0 && errno == EPIPE) {
+                struct timespec zero {0, 0};
+                sigtimedwait(&sigpipe, nullptr, &zero);
+            }
+
+            m_failed = true;
+            close(m_fd);
+            m_fd = -1;
+            break;
+        }
+
+        p += n;
+        left -= n;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    m_buf.clear();
+}
+
+bool AsmPipe::Close()
+{
+    Flush();
+
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+
+    if (m_pid < 0) {
+        return false;
+    }
+
+    int status = Process::Wait(m_pid);
+    m_pid = -1;
+
+    Profiler::childtime += Profiler::Now() - m_start;
+
+    return !m_failed && status == 0;
+}
+
+}
@@ -0,0 +1,149 @@
+#include <map>
+#include <mutex>
+#include <vector>
+#include <cstdio>
+#include <cstdlib>
+
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "profile.h"
+
+namespace c89 {
+
+struct TraceEvent
+{
+    const char *name;
+    uint64_t start;
+    uint64_t end;
+    long tid;
+};
+
+static std::mutex events_lock;
+static std::vector<TraceEvent> events;
+static std::string tracepath;
+static bool timereport = false;
+static uint64_t starttime = 0;
+
+bool Profiler::enabled = false;
+std::atomic<uint64_t> Profiler::tokens {0};
+std::atomic<uint64_t> Profiler::bytes {0};
+std::atomic<uint64_t> Profiler::allocations {0};
+std::atomic<uint64_t> Profiler::children {0};
+std::atomic<uint64_t> Profiler::childtime {0};
+std::atomic<uint64_t> Profiler::arenachunks {0};
+std::atomic<uint64_t> Profiler::remotejobs {0};
+std::atomic<uint64_t> Profiler::remotebytes {0};
+std::atomic<uint64_t> Profiler::arenabytes {0};
+
+void Profiler::Enable(bool report, const std::string& tracefile)
+{
+    if (!report && tracefile.empty()) {
+        return;
+    }
+
+    timereport = report;
+    tracepath = tracefile;
+    starttime = Now();
+    enabled = true;
+
+    // phases may end in exit(), e.g. Assembler with -c
+    atexit(Report);
+}
+
+uint64_t Profiler::Now()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void Profiler::Record(const char *name, uint64_t start, uint64_t end)
+{
+    static thread_local long tid = syscall(SYS_gettid);
+    std::lock_guard<std::mutex> lock(events_lock);
+
+    events.push_back({name, start, end, tid});
+}
+
+void Profiler::Report()
+{
+    uint64_t total = Now() - starttime;
+
+    if (!tracepath.empty()) {
+        WriteTrace();
+    }
+
+    if (!timereport) {
+        return;
+    }
+
+    // phases in first-seen order, summed over threads
+    std::vector<std::pair<const char *, uint64_t>> phases;
+    std::map<std::string, size_t> index;
+
+    for (auto& e : events)
+    {
+        auto it = index.find(e.name);
+        if (it == index.end()) {
+            index.emplace(e.name, phases.size());
+            phases.emplace_back(e.name, 0);
+            it = index.find(e.name);
+        }
+        phases[it->second].second += e.end - e.start;
+    }
+
+    fprintf(stderr, "\nExecution times (seconds)\n");
+    for (auto& p : phases)
+    {
+        fprintf(stderr, " %-24s: %8.4f (%3.0f%%) wall\n", p.first, p.second / 1e9,
+                total ? 100.0 * p.second / total : 0.0);
+    }
+    fprintf(stderr, " %-24s: %8.4f\n", "TOTAL", total / 1e9);
+
+    fprintf(stderr, "\nCounters\n");
+    fprintf(stderr, " %-24s: %llu\n", "tokens lexed", (unsigned long long)tokens);
+    fprintf(stderr, " %-24s: %llu\n", "bytes read", (unsigned long long)bytes);
+    fprintf(stderr, " %-24s: %llu (%.4f s wall)\n", "child processes",
+            (unsigned long long)children, childtime / 1e9);
+    fprintf(stderr, " %-24s: %llu\n", "arena allocations", (unsigned long long)allocations);
+    fprintf(stderr, " %-24s: %llu (%llu KB)\n", "arena chunks",
+            (unsigned long long)arenachunks, (unsigned long long)arenabytes / 1024);
+    fprintf(stderr, " %-24s: %llu (%llu KB on the wire)\n", "remote jobs",
+            (unsigned long long)remotejobs, (unsigned long long)remotebytes / 1024);
+}
+
+// Chrome trace-event format, load it in chrome://tracing or Perfetto
+void Profiler::WriteTrace()
+{
+    FILE *fp;
+    int pid = getpid();
+
+    fp = fopen(tracepath.c_str(), "w");
+    if (!fp) {
+        fprintf(stderr, "warning: can not write trace file %s\n", tracepath.c_str());
+        return;
+    }
+
+    fprintf(fp, "{\"traceEvents\":[\n");
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const TraceEvent& e = events[i];
+        fprintf(fp, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%ld}%s\n",
+                e.name, (e.start - starttime) / 1e3, (e.end - e.start) / 1e3, pid, e.tid,
+                i + 1 < events.size() ? "," : "");
+    }
+    fprintf(fp, "],\n\"otherData\":{\"tokens\":%llu,\"bytes\":%llu,\"allocations\":%llu,"
+            "\"children\":%llu,\"childtime_us\":%.3f,\"arenachunks\":%llu,\"arenabytes\":%llu,"
+            "\"remotejobs\":%llu,\"remotebytes\":%llu}}\n",
+            (unsigned long long)tokens, (unsigned long long)bytes,
+            (unsigned long long)allocations, (unsigned long long)children, childtime / 1e3,
+            (unsigned long long)arenachunks, (unsigned long long)arenabytes,
+            (unsigned long long)remotejobs, (unsigned long long)remotebytes);
+
+    fclose(fp);
+}
+
+}
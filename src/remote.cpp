@@ -0,0 +1,635 @@
+#include <cerrno>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <system_error>
+
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "log.h"
+#include "files.h"
+#include "remote.h"
+#include "profile.h"
+#include "process.h"
+#include "compress.h"
+#include "mappedfile.h"
+
+namespace c89 {
+
+static const uint16_t VERSION = 1;
+
+// upper bounds for a frame from the network
+static const uint32_t MAXNAME = 4096;
+static const uint64_t MAXPAYLOAD = 1ull << 31;
+
+// [host:]port, host defaults to the loopback address
+static void SplitAddr(const std::string& addr, std::string& host, std::string& port)
+{
+    auto pos = addr.find_last_of(':');
+    if (pos == addr.npos) {
+        host = "127.0.0.1";
+        port = addr;
+    } else {
+        host = addr.substr(0, pos);
+        port = addr.substr(pos + 1);
+    }
+}
+
+Channel::~Channel()
+{
+    close(m_fd);
+}
+
+bool Channel::Send(FrameKind kind, uint32_t flags, const std::string& name,
+                   const char *data, size_t len)
+{
+    Frame f;
+    const char *payload = data;
+
+    memcpy(f.magic, "C--R", 4);
+    f.version = VERSION;
+    f.kind = kind;
+    f.flags = flags;
+    f.namelen = name.size();
+    f.rawsize = len;
+    f.size = len;
+
+    // compressed into the reused buffer, or sent straight from data
+    if (len) {
+        Lz4::Compress(data, len, m_wire);
+        if (m_wire.size() < len) {
+            payload = m_wire.data();
+            f.size = m_wire.size();
+        }
+    }
+
+    struct iovec iov[3] = {
+        {&f, sizeof(f)},
+        {(void *)name.data(), name.size()},
+        {(void *)payload, f.size},
+    };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 3;
+
+    while (msg.msg_iovlen > 0)
+    {
+        ssize_t n = sendmsg(m_fd, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0) {
+            return false;
+        }
+
+        Profiler::remotebytes += n;
+
+        // skip what was sent
+        while (msg.msg_iovlen > 0 && (size_t)n >= msg.msg_iov->iov_len)
+        {
+            n -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0) {
+            msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + n;
+            msg.msg_iov->iov_len -= n;
+        }
+    }
+
+    return true;
+}
+
+bool Channel::ReadFull(char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = recv(m_fd, buf, len, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+
+        Profiler::remotebytes += n;
+        buf += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+bool Channel::Receive(Frame& f, std::string& name)
+{
+    if (!ReadFull((char *)&f, sizeof(f))) {
+        return false;
+    }
+
+    if (memcmp(f.magic, "C--R", 4) || f.version != VERSION || f.namelen > MAXNAME ||
+        f.rawsize > MAXPAYLOAD || f.size > f.rawsize) {
+        return false;
+    }
+
+    name.resize(f.namelen);
+    if (!ReadFull(&name[0], f.namelen)) {
+        return false;
+    }
+
+    m_raw.resize(f.rawsize);
+    if (f.size == f.rawsize) {
+        return ReadFull(&m_raw[0], f.size);
+    }
+
+    m_wire.resize(f.size);
+    return ReadFull(&m_wire[0], f.size) &&
+           Lz4::Decompress(m_wire.data(), f.size, &m_raw[0], f.rawsize);
+}
+
+// an address or network of --worker-allow
+struct Subnet
+{
+    int family;
+    unsigned char addr[16];
+    int bits;
+};
+
+// a.b.c.d[/bits] or an IPv6 address[/bits]
+static bool ParseSubnet(const std::string& str, Subnet& net)
+{
+    auto slash = str.find('/');
+    std::string host = str.substr(0, slash);
+
+    memset(&net, 0, sizeof(net));
+
+    if (inet_pton(AF_INET, host.c_str(), net.addr) == 1) {
+        net.family = AF_INET;
+        net.bits = 32;
+    } else if (inet_pton(AF_INET6, host.c_str(), net.addr) == 1) {
+        net.family = AF_INET6;
+        net.bits = 128;
+    } else {
+        return false;
+    }
+
+    if (slash != str.npos) {
+        const char *b = str.c_str() + slash + 1;
+        char *end;
+        long bits = strtol(b, &end, 10);
+
+        if (!*b || *end || bits < 0 || bits > net.bits) {
+            return false;
+        }
+        net.bits = bits;
+    }
+
+    return true;
+}
+
+// family and address bytes of sa, IPv4-mapped IPv6 addresses as IPv4
+static int AddressOf(const struct sockaddr *sa, const unsigned char **addr)
+{
+    if (sa->sa_family == AF_INET) {
+        *addr = (const unsigned char *)&((const struct sockaddr_in *)sa)->sin_addr;
+        return AF_INET;
+    }
+
+    if (sa->sa_family == AF_INET6) {
+        const struct in6_addr *a = &((const struct sockaddr_in6 *)sa)->sin6_addr;
+        if (IN6_IS_ADDR_V4MAPPED(a)) {
+            *addr = a->s6_addr + 12;
+            return AF_INET;
+        }
+        *addr = a->s6_addr;
+        return AF_INET6;
+    }
+
+    return AF_UNSPEC;
+}
+
+static bool IsLoopback(int family, const unsigned char *addr)
+{
+    static const unsigned char loopback6[16] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+
+    if (family == AF_INET) {
+        return addr[0] == 127;
+    }
+
+    return family == AF_INET6 && !memcmp(addr, loopback6, 16);
+}
+
+static bool InSubnet(const Subnet& net, int family, const unsigned char *addr)
+{
+    int bytes = net.bits / 8, bits = net.bits % 8;
+
+    if (family != net.family || memcmp(addr, net.addr, bytes)) {
+        return false;
+    }
+
+    return !bits || !((addr[bytes] ^ net.addr[bytes]) & (0xff << (8 - bits)));
+}
+
+// what compilers emit; .cfi_* is matched as a prefix
+static const char *directives[] = {
+    "text", "data", "bss", "section", "previous", "pushsection", "popsection",
+    "globl", "global", "local", "weak", "hidden", "protected", "internal",
+    "type", "size", "set", "equ", "comm", "lcomm",
+    "align", "p2align", "balign", "byte", "short", "value", "word", "int", "long",
+    "quad", "octa", "float", "double", "uleb128", "sleb128", "zero", "skip", "space",
+    "string", "ascii", "asciz", "file", "loc", "ident", "addrsig", "addrsig_sym",
+    "code64", "att_syntax", "intel_syntax",
+};
+
+static bool KnownDirective(const char *word, size_t len)
+{
+    if (len > 4 && !strncasecmp(word, "cfi_", 4)) {
+        return true;
+    }
+
+    for (auto d : directives)
+    {
+        if (strlen(d) == len && !strncasecmp(word, d, len)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*
+ * Only the directives compilers emit are assembled remotely: .incbin and
+ * .include would read files of the worker, and .macro, .rept, .irp and
+ * the like let a few lines expand without bound. Statements are split on
+ * newlines and ';' outside strings, labels are skipped, and a directive
+ * must then be in the list. Anything this scan does not follow (character
+ * constants, block comments) is refused too; a refusal only costs a local
+ * assembly.
+ */
+static bool RemoteSafe(const std::string& text)
+{
+    size_t i = 0, n = text.size();
+
+    auto symchar = [](char c) {
+        return isalnum((unsigned char)c) || c == '_' || c == '.' || c == '$';
+    };
+
+    while (i < n)
+    {
+        while (i < n && (text[i] == ' ' || text[i] == '\t' || text[i] == '\r' || text[i] == '\f'))
+        {
+            i++;
+        }
+
+        size_t start = i;
+        while (i < n && symchar(text[i]))
+        {
+            i++;
+        }
+        size_t end = i;
+
+        while (i < n && (text[i] == ' ' || text[i] == '\t'))
+        {
+            i++;
+        }
+
+        // a label, the statement goes on after it
+        if (end > start && i < n && text[i] == ':') {
+            i++;
+            continue;
+        }
+
+        // a directive unless it is an assignment, .L1 = .
+        bool assign = i < n && text[i] == '=' && (i + 1 == n || text[i + 1] != '=');
+        if (end > start && text[start] == '.' && !assign &&
+            !KnownDirective(&text[start + 1], end - start - 1)) {
+            return false;
+        }
+
+        // operands up to the end of the statement
+        while (i < n && text[i] != '\n' && text[i] != ';')
+        {
+            if (text[i] == '#') {
+                while (i < n && text[i] != '\n')
+                {
+                    i++;
+                }
+                break;
+            }
+
+            if (text[i] == '\'' || (text[i] == '/' && i + 1 < n && text[i + 1] == '*')) {
+                return false;
+            }
+
+            if (text[i] == '"') {
+                for (i++; i < n && text[i] != '"' && text[i] != '\n'; i++)
+                {
+                    if (text[i] == '\\' && i + 1 < n && text[i + 1] != '\n') {
+                        i++;
+                    }
+                }
+                if (i < n && text[i] == '"') {
+                    i++;
+                }
+                continue;
+            }
+
+            i++;
+        }
+
+        // the separator
+        i++;
+    }
+
+    return true;
+}
+
+// pipe the text to as, read the object back; the driver reports errors
+static bool AssembleText(const std::string& text, std::string& obj)
+{
+    char path[] = "/tmp/c--XXXXXX.o";
+    int fd = mkstemps(path, 2);
+    if (fd < 0) {
+        return false;
+    }
+    close(fd);
+
+    AsmPipe as;
+    if (as.Open(path, true)) {
+        as.Write(text);
+    }
+
+    bool ok = as.Close() && Files::ReadFile(path, obj);
+    unlink(path);
+
+    return ok;
+}
+
+int Worker::Listen(const std::string& addr, const std::vector<std::string>& allow)
+{
+    int fd, on = 1;
+    std::string host, port;
+    struct addrinfo hints, *res;
+    std::vector<Subnet> nets;
+    const unsigned char *bytes = nullptr;
+
+    for (const auto& a : allow)
+    {
+        Subnet net;
+        if (!ParseSubnet(a, net)) {
+            Error::Fatal("invalid address in '--worker-allow': " + a);
+        }
+        nets.push_back(net);
+    }
+
+    // as is killed by SIGXFSZ rather than fill the disk: no object larger
+    // than a frame can carry is of any use
+    struct rlimit fsize;
+    if (!getrlimit(RLIMIT_FSIZE, &fsize) && fsize.rlim_cur > MAXPAYLOAD) {
+        fsize.rlim_cur = MAXPAYLOAD;
+        setrlimit(RLIMIT_FSIZE, &fsize);
+    }
+
+    SplitAddr(addr, host, port);
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res)) {
+        Error::Fatal("can not resolve worker address " + addr);
+    }
+
+    int family = AddressOf(res->ai_addr, &bytes);
+    if (nets.empty() && !IsLoopback(family, bytes)) {
+        Error::Fatal("refusing to listen on " + addr + " without '--worker-allow'");
+    }
+
+    fd = socket(res->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) ||
+        bind(fd, res->ai_addr, res->ai_addrlen) || listen(fd, 64)) {
+        Error::Fatal("can not listen on " + addr);
+    }
+    freeaddrinfo(res);
+
+    // one thread per driver connection
+    while (true)
+    {
+        struct sockaddr_storage peer;
+        socklen_t len = sizeof(peer);
+
+        int conn = accept4(fd, (struct sockaddr *)&peer, &len, SOCK_CLOEXEC);
+        if (conn < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            // out of descriptors or memory, wait for connections to close
+            if (errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+                usleep(100000);
+                continue;
+            }
+            Error::Fatal("accept failed on " + addr);
+        }
+
+        family = AddressOf((struct sockaddr *)&peer, &bytes);
+        bool allowed = IsLoopback(family, bytes);
+        for (size_t i = 0; i < nets.size() && !allowed; i++)
+        {
+            allowed = InSubnet(nets[i], family, bytes);
+        }
+
+        if (!allowed) {
+            char name[INET6_ADDRSTRLEN] = "?";
+            inet_ntop(family, bytes, name, sizeof(name));
+            Error::Warning(std::string("refused connection from ") + name);
+            close(conn);
+            continue;
+        }
+
+        setsockopt(conn, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        try {
+            std::thread(&Worker::Serve, conn).detach();
+        } catch (const std::system_error&) {
+            close(conn);
+        }
+    }
+
+    return 0;
+}
+
+void Worker::Serve(int fd)
+{
+    Frame f;
+    std::string name, obj;
+    Channel ch(fd);
+
+    // a job that fails, even by running out of memory, only fails itself
+    try {
+        while (ch.Receive(f, name))
+        {
+            bool sent;
+
+            if (f.kind == R_ASSEMBLE && f.flags == 0 && RemoteSafe(ch.Payload()) && AssembleText(ch.Payload(), obj)) {
+                sent = ch.Send(R_OBJECT, 0, name, obj.data(), obj.size());
+            } else {
+                sent = ch.Send(R_FAILED, 0, name, nullptr, 0);
+            }
+
+            if (!sent) {
+                break;
+            }
+        }
+    } catch (const std::exception&) {
+    }
+}
+
+Scheduler* Scheduler::Get(const CcArg& arg)
+{
+    static std::unique_ptr<Scheduler> scheduler;
+    static std::once_flag once;
+
+    std::call_once(once, [&arg]() {
+        if (!arg.workers.empty()) {
+            scheduler.reset(new Scheduler(arg.workers));
+        }
+    });
+
+    return scheduler.get();
+}
+
+Scheduler::Scheduler(const std::vector<std::string>& workers)
+{
+    for (const auto& w : workers)
+    {
+        // the count was checked by CcArg::ParseArgs
+        if (!w.compare(0, 6, "local:")) {
+            StartLoopback(strtoul(w.c_str() + 6, nullptr, 10));
+            continue;
+        }
+
+        int fd = Connect(w);
+        if (fd < 0) {
+            Error::Warning("worker " + w + " is not reachable, compiling locally");
+            continue;
+        }
+        channels.emplace_back(new Channel(fd));
+    }
+
+    for (auto& ch : channels)
+    {
+        idle.push_back(ch.get());
+    }
+}
+
+Scheduler::~Scheduler()
+{
+    // loopback workers see the connection close and return
+    idle.clear();
+    channels.clear();
+
+    for (auto& t : loopback)
+    {
+        t.join();
+    }
+}
+
+int Scheduler::Connect(const std::string& addr)
+{
+    int fd = -1, on = 1;
+    std::string host, port;
+    struct addrinfo hints, *res;
+
+    SplitAddr(addr, host, port);
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res)) {
+        return -1;
+    }
+
+    for (auto *ai = res; ai; ai = ai->ai_next)
+    {
+        fd = socket(ai->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && !connect(fd, ai->ai_addr, ai->ai_addrlen)) {
+            break;
+        }
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(res);
+
+    if (fd >= 0) {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    }
+
+    return fd;
+}
+
+void Scheduler::StartLoopback(size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv)) {
+            Error::Fatal("can not create loopback worker");
+        }
+
+        channels.emplace_back(new Channel(sv[0]));
+        loopback.emplace_back(&Worker::Serve, sv[1]);
+    }
+}
+
+bool Scheduler::Assemble(const std::string& file, const std::string& obj)
+{
+    Frame f;
+    MappedFile src;
+    std::string name;
+    Channel *ch;
+
+    // busy workers are not waited for, the caller compiles locally
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (idle.empty()) {
+            return false;
+        }
+        ch = idle.back();
+        idle.pop_back();
+    }
+
+    ScopedTimer t("remote as");
+
+    bool ok = false, alive = true;
+    if (src.Open(file)) {
+        alive = ch->Send(R_ASSEMBLE, 0, file, (const char *)src.data, src.size) &&
+                ch->Receive(f, name);
+        ok = alive && f.kind == R_OBJECT && Files::WriteFile(obj, ch->Payload());
+    }
+
+    if (ok) {
+        Profiler::remotejobs++;
+    }
+
+    // a broken connection is not used again
+    std::lock_guard<std::mutex> guard(lock);
+    if (alive) {
+        idle.push_back(ch);
+    }
+
+    return ok;
+}
+
+}
@@ -0,0 +1,185 @@
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#include <unistd.h>
+
+#include "tokenize.h"
+#include "tokenfile.h"
+
+namespace c89 {
+
+static_assert(sizeof(TokenFile::Header) == 56, "token file header layout");
+static_assert(sizeof(TokenFile::Record) == 40, "token file record layout");
+
+static uint64_t Align(uint64_t n, uint64_t align)
+{
+    return (n + align - 1) & ~(align - 1);
+}
+
+bool TokenFile::Write(const std::string& path, const std::vector<const Token*>& tokens,
+                      const std::string& source)
+{
+    Header h;
+    std::string strtab;
+    std::vector<Record> recs;
+    std::unordered_map<std::string, uint32_t> strmap;
+
+    recs.reserve(tokens.size());
+
+    for (const Token *t : tokens)
+    {
+        Record r;
+        memset(&r, 0, sizeof(r));
+
+        r.type = t->type;
+        r.offset = t->offset;
+        r.length = t->length;
+
+        const std::string *s = nullptr;
+        switch (t->type)
+        {
+        case TK_IDENT:
+            s = &t->ident_name;
+            break;
+        case TK_STR:
+            s = &t->string_literal;
+            break;
+        case TK_OPEOR:
+            r.kind = t->operate;
+            break;
+        case TK_SEPOR:
+            r.kind = t->separator;
+            break;
+        case TK_NUM:
+            r.kind = t->numtype;
+            memcpy(r.number, &t->number_literal, std::min(sizeof(r.number), sizeof(t->number_literal)));
+            break;
+        case TK_CHAR:
+            r.character = t->char_literal;
+            break;
+        }
+
+        if (s) {
+            auto it = strmap.find(*s);
+            if (it == strmap.end()) {
+                it = strmap.emplace(*s, strtab.size()).first;
+                strtab += *s;
+            }
+            r.str = it->second;
+            r.strlen = s->size();
+        }
+
+        recs.push_back(r);
+    }
+
+    memcpy(h.magic, "C--T", 4);
+    h.version = VERSION;
+    h.ntokens = recs.size();
+    h.tokoff = Align(sizeof(Header), 16);
+    h.stroff = h.tokoff + recs.size() * sizeof(Record);
+    h.strsize = strtab.size();
+    h.srcoff = h.stroff + strtab.size();
+    h.srcsize = source.size();
+
+    std::string image(h.srcoff + source.size(), '\0');
+    memcpy(&image[0], &h, sizeof(h));
+    if (!recs.empty()) {
+        memcpy(&image[h.tokoff], recs.data(), recs.size() * sizeof(Record));
+    }
+    image.replace(h.stroff, strtab.size(), strtab);
+    image.replace(h.srcoff, source.size(), source);
+
+    FILE *fp;
+    auto tmp = path + "." + std::to_string(getpid());
+
+    fp = fopen(tmp.c_str(), "w");
+    if (!fp) {
+        return false;
+    }
+
+    size_t n = fwrite(image.data(), 1, image.size(), fp);
+
+    if (fclose(fp) || n != image.size() || rename(tmp.c_str(), path.c_str())) {
+        unlink(tmp.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool TokenFile::Open(const std::string& path)
+{
+    std::unique_ptr<MappedFile> f(new MappedFile);
+
+    if (!f->Open(path) || f->size < sizeof(Header)) {
+        return false;
+    }
+
+    const Header *h = (const Header *)f->data;
+    if (memcmp(h->magic, "C--T", 4) || h->version != VERSION) {
+        return false;
+    }
+
+    // sections in order and inside the file; every subtraction is from a
+    // value already known to be larger, every sum is bounded by the size
+    if (h->tokoff % 16 || h->tokoff < sizeof(Header) || h->tokoff > f->size ||
+        h->ntokens > (f->size - h->tokoff) / sizeof(Record) ||
+        h->stroff != h->tokoff + h->ntokens * sizeof(Record) ||
+        h->strsize > f->size - h->stroff ||
+        h->srcoff != h->stroff + h->strsize ||
+        h->srcsize != f->size - h->srcoff) {
+        return false;
+    }
+
+    const Record *recs = (const Record *)(f->data + h->tokoff);
+    for (size_t i = 0; i < h->ntokens; i++)
+    {
+        const Record& r = recs[i];
+        if (r.type > TK_CHAR || r.str > h->strsize || r.strlen > h->strsize - r.str ||
+            r.offset > h->srcsize || r.length > h->srcsize - r.offset) {
+            return false;
+        }
+    }
+
+    header = h;
+    records = recs;
+    strings = (const char *)f->data + h->stroff;
+    source = (const char *)f->data + h->srcoff;
+    file = std::move(f);
+
+    return true;
+}
+
+void TokenFile::Decode(const Record& r, Token& tok) const
+{
+    tok.type = (TokenType)r.type;
+    tok.offset = r.offset;
+    tok.length = r.length;
+
+    switch (tok.type)
+    {
+    case TK_IDENT:
+        tok.ident_name = String(r);
+        break;
+    case TK_STR:
+        tok.string_literal = String(r);
+        break;
+    case TK_OPEOR:
+        tok.operate = (Operators)r.kind;
+        break;
+    case TK_SEPOR:
+        tok.separator = (Separators)r.kind;
+        break;
+    case TK_NUM:
+        tok.numtype = (NumType)r.kind;
+        memcpy(&tok.number_literal, r.number, std::min(sizeof(r.number), sizeof(tok.number_literal)));
+        break;
+    case TK_CHAR:
+        tok.char_literal = r.character;
+        break;
+    }
+}
+
+}
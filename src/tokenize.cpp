@@ -1,14 +1,14 @@
 #include <ostream>
-#include <sstream>
-#include <fstream>
-#include <iomanip>
 
 #include <cctype>
+#include <cstdio>
 #include <cstring>
 #include <cstdlib>
 
 #include "log.h"
+#include "profile.h"
 #include "tokenize.h"
+#include "tokenfile.h"
 
 namespace c89 {
 
@@ -25,94 +25,80 @@ static const std::map<std::string, KeyWords> keywords = {
     {"void", K_VOID}, {"sizeof", K_SIZEOF}, {"return", K_RETURN},
 };
 
-static const std::map<Operators, std::string> operators = {
-    {O_PLUS, "+"}, {O_SUB, "-"}, {O_MUL, "*"}, {O_DIV, "/"},
-    {O_INC, "++"}, {O_DEC, "--"},
-    {O_AND, "&&"}, {O_OR, "||"}, {O_NOT, "!"},
-    {O_EQUAL, "=="}, {O_NOTEQUAL, "!="}, {O_LOWER, "<"}, {O_LOWEQUAL, "<="},
-    {O_GREATER, ">"}, {O_GREAEQUAL, ">="}, 
-    {O_ASSIGN, "="}, {O_PLUSASSIGN, "+="}, {O_SUBASSIGN, "-="}, {O_MULASSIGN, "*="},
-    {O_DIVASSIGN, "/="}, {O_COMPASSIGN, "%="}, {O_SHLASSIGN, "<<="}, {O_RHLASSIGN, ">>="},
-    {O_ANDASSIGN, "&="}, {O_ORASSIGN, "|="}, {O_XORASSIGN, "^="}, {O_NEGASSIGN, "~="},
-    {O_SHL, "<<"}, {O_RHL, ">>"}, {O_BTIAND, "&"}, {O_BITOR, "|"}, {O_BITXOR, "^"}, {O_BITNEG, "~"},
-    {O_ARROW, "->"}, {O_COND, "?"},
+static const char *kinds[] = {
+    "ident", "punct", "operator", "string", "number", "char",
 };
 
-static const std::map<Separators, std::string> separators = {
-    {S_COMMA, ","}, {S_DOT, "."}, {S_COLON, ":"}, {S_EMICLON, ";"},
-    {S_LPARET, "("}, {S_RPARET, ")"}, {S_LSQBRCKT, "["}, {S_RSQBRCKT, "]"},
-    {S_LCUBRCKT, "{"}, {S_RCUBRCKT, "}"},
-};
-
-void Tokenizer::TokenizeFiles(const CcArg& arg, const Files& files)
+/*
+ * One line per token: kind, spelling and byte offset, separated by tabs.
+ * Control characters and backslashes in the spelling are escaped.
+ */
+void Tokenizer::Dump(const std::string& content)
 {
-    std::ifstream ifs;
-    std::ostringstream stream;
+    std::string out;
 
-    // 这里应只遍历tmpcfiles
-    for (const auto& vec : {files.cfiles, files.tmpcfiles})
+    for (auto& t : tokenlist)
     {
-        for (const auto& s : vec)
+        if (t->type == TK_IDENT && keywords.count(t->ident_name)) {
+            out += "keyword";
+        } else {
+            out += kinds[t->type];
+        }
+        out += '\t';
+
+        for (const char *p = &content[t->offset]; p < &content[t->offset + t->length]; p++)
         {
-            ifs.open(s, std::ios::in);
-            if (!ifs.is_open()) {
-                Error::Fatal("File "+s+" not found");
+            if (*p == '\\') {
+                out += "\\\\";
+            } else if (*p == '\n') {
+                out += "\\n";
+            } else if (*p == '\t') {
+                out += "\\t";
+            } else if (iscntrl(*p)) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\x%02x", (unsigned char)*p);
+                out += buf;
+            } else {
+                out += *p;
             }
-
-            stream << ifs.rdbuf();
-
-            Tokenize(arg, s, stream.str());
-
-            stream.clear();
-            ifs.close();
         }
+
+        out += '\t';
+        out += std::to_string(t->offset);
+        out += '\n';
     }
 
-    // debug
-    for (auto& t : tokenlist)
+    std::cout.write(out.data(), out.size());
+}
+
+void Tokenizer::Load(const TokenFile& file)
+{
+    for (size_t i = 0; i < file.Count(); i++)
     {
-        if (t->type == TK_IDENT) {
-            std::cout << t->ident_name << std::endl;
-        }
-        else if (t->type == TK_STR) {
-            std::cout << "\"" << t->string_literal << "\"" << std::endl;
-        }
-        else if (t->type == TK_CHAR) {
-            std::cout << t->char_literal << std::endl;
-        }
-        else if (t->type == TK_OPEOR) {
-            auto it = operators.find(t->operate);
-            if (it == operators.end()) {
-                Error::Fatal("internal error");
-            }
-            std::cout << it->second << std::endl;
-        }
-        else if (t->type == TK_SEPOR) {
-            auto it = separators.find(t->separator);
-            if (it == separators.end()) {
-                Error::Fatal("internal error");
-            }
-            std::cout << it->second << std::endl;
-        }
-        else if (t->type == TK_NUM) {
-            if ((int)t->numtype > N_ULONGLONG) {
-                // cout 默认输出6位, setprecision 设置精度
-                std::cout << std::setprecision(16) << t->number_literal.ldouble_literal << std::endl;
-            } else {
-                std::cout << t->number_literal.ullong_literal << std::endl;
-            }
-        }
-     }
+        std::shared_ptr<Token> tok {NewToken()};
+        file.Decode(file[i], *tok);
+        tokenlist.emplace_back(tok);
+    }
 }
 
 void Tokenizer::Tokenize(const CcArg& arg, const std::string& file, const std::string& content)
 {
     Content c (file, content);
+    size_t ntokens = tokenlist.size();
+
+    Profiler::bytes += content.size();
+
+    // about one token per 5 bytes of C at ~200 arena bytes each, rather
+    // under than over: the arena doubles its chunks when it runs out
+    arena.SizeHint(content.size() * 32);
 
     while (*c)
     {
-        // skip space
-        if (isspace(*c) || iscntrl(*c) || isblank(*c)) {
+        size_t start = c.Offset();
+        size_t n = tokenlist.size();
+
+        // skip space; other control characters are not in the source character set
+        if (isspace(*c)) {
             ++c;
             continue;
         }
@@ -132,16 +118,25 @@ void Tokenizer::Tokenize(const CcArg& arg, const std::string& file, const std::s
         } else if (ispunct(*c)) {
             TokenPunct(c);
         } else {
-            Error::Fatal(c.Location() + "Unrecognized Character" + c.Currline());
+            diags.Error(D_UNRECOGNIZED_CHAR, c.Offset());
+            ++c;
+        }
+
+        // every scanner adds at most one token
+        if (tokenlist.size() != n) {
+            tokenlist.back()->offset = start;
+            tokenlist.back()->length = c.Offset() - start;
         }
     }
+
+    Profiler::tokens += tokenlist.size() - ntokens;
 }
 
 /* Identifier */
 void Tokenizer::TokenIdent(Content& c)
 {
     const char* start {c.Str()};
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     while (*(++c))
     {
@@ -159,34 +154,41 @@ void Tokenizer::TokenIdent(Content& c)
     tokenlist.emplace_back(tok);
 }
 
-/* String */
+/* String, escape sequences are checked but kept as written */
 void Tokenizer::TokenString(Content& c)
 {
     Content start {c};
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    bool ok {true};
+    int ch;
 
-    while (*++c)
+    /* a newline ends the line, not the string: it is unterminated */
+    ++c;
+    while (*c && *c != '\n' && *c != '\"')
     {
-        /* find terminated character */
-        if (*c == '\"') {
-
-            /* skip \" */
-            if (*(c-1) == '\\') {
-                continue;
+        if (*c == '\\') {
+            if (!EscapeChar(c, &ch)) {
+                ok = false;
             }
+            continue;
+        }
+        ++c;
+    }
 
-            /* get string */
-            tok->type = TK_STR;
-            tok->string_literal = std::string(start+1, c.Str());
-            tokenlist.emplace_back(tok);
+    if (*c != '\"') {
+        diags.Error(D_UNTERMINATED_STRING, start.Offset());
+        return;
+    }
 
-            /* jump terminated character \" */
-            ++c;
-            return;
-        }
+    /* jump terminated character \" */
+    ++c;
+    if (!ok) {
+        return;
     }
 
-    Error::Fatal(start.Location() + "Missing terminating \" character" + start.Currline());
+    std::shared_ptr<Token> tok {NewToken()};
+    tok->type = TK_STR;
+    tok->string_literal = std::string(start+1, c-1);
+    tokenlist.emplace_back(tok);
 }
 
 /*
@@ -207,128 +209,123 @@ void Tokenizer::TokenString(Content& c)
  */
 void Tokenizer::TokenNum(Content& c)
 {
-    int loop {1};
-    int base {10};
-    Content start {c};
-    NumType type {N_INT};
-
-    /* get number base */
-    if (*start == '0') {
-        base = 8;
-        if ((*(start+1) == 'x'||*(start+1)=='X') && isxdigit(*(start+2))) {
-            base = 16;
-            start += 2;
-            c += 2;
-        }
-    }
+    const char *start {c.Str()};
+    size_t offset {c.Offset()};
 
-    /* find suffix or end */
+    /*
+     * the whole preprocessing number first (C89 3.1.8): 1e+5 is one token,
+     * and so are 09, 0x1e+1 and 12ab, which are then no valid constant
+     */
+    ++c;
     while (*c)
     {
-        /* float, 由于e作为科学计数法标识且是16进制字符，因此当base为16时，e不能被识别为科学计数法标识 */
-        if (*c == '.' || ((*c == 'e' || *c == 'E') && base != 16)) {
-            type = N_DOUBLE;
-            ++c;
-        } else if (base == 16 && isxdigit(*c)) {
-            ++c;
-        } else if (base == 8 && *c >= '0' && *c <= '7') {
-            ++c;
-        } else if (base == 10 && isdigit(*c)) {
+        if ((*c == 'e' || *c == 'E') && (*(c+1) == '+' || *(c+1) == '-')) {
+            c += 2;
+        } else if (isalnum(*c) || *c == '_' || *c == '.') {
             ++c;
         } else {
             break;
         }
     }
 
-    /* find number end */
-    Content suffix {c};
-    while (*c && loop)
-    {
-        switch (*c)
+    const char *end {c.Str()};
+    const char *p {start};
+
+    /* hex integer */
+    if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+        p += 2;
+        const char *digits {p};
+        while (p < end && isxdigit(*p))
         {
-        case 'f': case 'F':
-        case 'l': case 'L':
-        case 'u': case 'U':
-            ++c;
-            break;
-        /* termniated */
-        default:
-            loop = 0;
+            p++;
         }
+
+        if (p == digits) {
+            diags.Error(D_NO_HEX_DIGITS, offset);
+            return;
+        }
+
+        TokenInteger(digits, p, end, 16, offset);
+        return;
     }
 
-    if (type == N_INT) {
-        TokenInteger(start, suffix, c, base);
-    } else {
-        TokenFloat(start, suffix, c);
+    while (p < end && isdigit(*p))
+    {
+        p++;
     }
-}
 
-void Tokenizer::TokenInteger(Content& start, Content& suffix, Content& end, int base)
-{
-    int cnt {0};
-    NumType sufftype {N_INT};
-    uint64_t pow {1}, result{0};
-    std::shared_ptr<Token> tok = std::make_shared<Token>();
+    /* float: digits, then a fraction, an exponent or both */
+    if (p < end && (*p == '.' || *p == 'e' || *p == 'E')) {
+        if (*p == '.') {
+            p++;
+            while (p < end && isdigit(*p))
+            {
+                p++;
+            }
+        }
 
-    if (start == end) {
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            p++;
+            if (p < end && (*p == '+' || *p == '-')) {
+                p++;
+            }
+            if (p == end || !isdigit(*p)) {
+                diags.Error(D_EXPONENT, offset);
+                return;
+            }
+            while (p < end && isdigit(*p))
+            {
+                p++;
+            }
+        }
+
+        TokenFloat(start, p, end, offset);
         return;
     }
 
-    /* calculate */
-    cnt = suffix - start;
-    if (base == 10) {
-        while (cnt-- > 0)
-        {
-            result += (pow * (*(start+cnt) - '0'));
-            pow *= 10;
-        }
-    } else if (base == 8) {
-        while (cnt-- > 0)
-        {
-            result += (pow * (*(start+cnt) - '0'));
-            pow <<= 3;
+    TokenInteger(start, p, end, *start == '0' ? 8 : 10, offset);
+}
+
+void Tokenizer::TokenInteger(const char *start, const char *suffix, const char *end, int base,
+                             size_t offset)
+{
+    uint64_t result {0};
+
+    /* calculate, the constant must fit in 64 bits */
+    for (const char *p = start; p < suffix; p++)
+    {
+        uint64_t digit = HexchToint(*p);
+
+        if (digit >= (uint64_t)base) {
+            diags.Error(D_OCTAL_DIGIT, offset, *p);
+            return;
         }
-    } else {
-        while (cnt-- > 0)
-        {
-            result += (pow * HexchToint(*(start+cnt)));
-            pow <<= 4;
+
+        if (result > (UINT64_MAX - digit) / base) {
+            diags.Error(D_INT_RANGE, offset);
+            return;
         }
-    }
 
-    /* get suffix type, note: SuffixType will change suffix */
-    sufftype = SuffixType(suffix, end);
+        result = result * base + digit;
+    }
 
-    /* check type */
-    if ((int)sufftype > N_ULONGLONG)
-    {
-        Error::Fatal(end.Location() + "invalid suffix on int constant" +
-                     end.Currline());
+    NumType sufftype = SuffixType(suffix, end);
+    if (sufftype == N_UNKNOWN || sufftype > N_ULONGLONG) {
+        diags.Error(D_INT_SUFFIX, offset);
+        return;
     }
 
     /* new token */
+    std::shared_ptr<Token> tok = NewToken();
     tok->type = TK_NUM;
     tok->numtype = sufftype;
     tok->number_literal.ullong_literal = result;
     tokenlist.emplace_back(tok);
 }
 
-void Tokenizer::TokenFloat(Content& start, Content& suffix, Content& end)
+void Tokenizer::TokenFloat(const char *start, const char *suffix, const char *end, size_t offset)
 {
-    NumType sufftype{N_INT};
-    std::shared_ptr<Token> tok = std::make_shared<Token>();
-
-    if (start == end) {
-        return;
-    }
-    
-    /* calculate before 'SuffixType', because SuffixType will change suffix */
-    std::string num(start.Str(), suffix.Str());
-    tok->number_literal.ldouble_literal = strtold(num.c_str(), NULL);
-
-    /* get suffix type, note: SuffixType will change suffix */
-    sufftype = SuffixType(suffix, end);
+    NumType sufftype = SuffixType(suffix, end);
 
     /* check number type */
     switch (sufftype)
@@ -342,92 +339,55 @@ void Tokenizer::TokenFloat(Content& start, Content& suffix, Content& end)
         sufftype = N_DOUBLE;
         break;
     default:
-        Error::Fatal(end.Location() + "invalid suffix on float constant" + 
-            end.Currline());
+        diags.Error(D_FLOAT_SUFFIX, offset);
+        return;
     }
 
     /* new token */
+    std::shared_ptr<Token> tok = NewToken();
     tok->type = TK_NUM;
     tok->numtype = sufftype;
+    tok->number_literal.ldouble_literal = strtold(std::string(start, suffix).c_str(), NULL);
     tokenlist.emplace_back(tok);
 }
 
-/* U, UL, ULL, L, LU, LLU, LL, F, */
-NumType Tokenizer::SuffixType(Content& start, Content& end)
+/*
+ * integer suffixes u, l, ul, lu and the C99 ll, ull, llu in either case,
+ * but ll not as lL or Ll; f for float. N_UNKNOWN for anything else.
+ */
+NumType Tokenizer::SuffixType(const char *start, const char *end)
 {
-    int longcnt {0};
-    int ucnt {0};
-    NumType type{N_INT};
-
-    if (start == end) {
-        return type;
+    static const struct {
+        const char *suffix;
+        NumType type;
+    } suffixes[] = {
+        {"", N_INT}, {"u", N_UINT}, {"l", N_LONG}, {"ul", N_ULONG}, {"lu", N_ULONG},
+        {"ll", N_LONGLONG}, {"ull", N_ULONGLONG}, {"llu", N_ULONGLONG}, {"f", N_FLOAT},
+    };
+
+    char lower[4] {};
+    size_t len = end - start;
+
+    if (len > 3) {
+        return N_UNKNOWN;
     }
 
-    switch (*start)
+    for (size_t i = 0; i < len; i++)
     {
-    case 'f':
-    case 'F':
-        if (++start != end) {
-            Error::Fatal(start.Location() + "invalid suffix on floating constant" + 
-                            start.Currline());
-        }
-        return N_FLOAT;
-    case 'u':
-    case 'U':
-        type = N_UINT;
-        longcnt = 0;
-
-        while (++start != end)
-        {
-            if (*start == 'L' || *start == 'l') {
-                longcnt++;
-
-                if (longcnt > 2) {
-                    Error::Fatal(start.Location() + "invalid suffix on int constant" + 
-                                 start.Currline());
-                }
-            } else {
-                Error::Fatal(start.Location() + "invalid suffix on int constant" + 
-                                start.Currline());
-            }
+        lower[i] = tolower(start[i]);
+        if (i > 0 && lower[i] == 'l' && lower[i-1] == 'l' && start[i] != start[i-1]) {
+            return N_UNKNOWN;
         }
+    }
 
-        return (NumType)((int)type + longcnt);
-    case 'l':
-    case 'L':
-        type = N_INT;
-        longcnt = 1;
-
-        while (++start != end)
-        {
-            if (*start == 'L' || *start == 'l') {
-                longcnt++;
-                if (longcnt > 2) {
-                    Error::Fatal(start.Location() + "invalid suffix on int constant" + 
-                                 start.Currline());
-                }
-            } else if (*start == 'U' || *start == 'u') {
-                ucnt++;
-                type = N_UINT;
-
-                if (ucnt > 1) {
-                    Error::Fatal(start.Location() + "invalid suffix on int constant" + 
-                                 start.Currline());
-                }
-            } else {
-                Error::Fatal(start.Location() + "invalid suffix on int constant" + 
-                            start.Currline());
-            }
+    for (const auto& s : suffixes)
+    {
+        if (!strcmp(lower, s.suffix)) {
+            return s.type;
         }
-
-        return (NumType)((int)type + longcnt);
-        break;
-    default:
-        Error::Fatal(start.Location() + "invalid suffix" + '\'' + *start + '\'' +
-                start.Currline());
     }
 
-    return type;
+    return N_UNKNOWN;
 }
 
 /* 
@@ -448,43 +408,67 @@ NumType Tokenizer::SuffixType(Content& start, Content& end)
 void Tokenizer::TokenChar(Content& c)
 {
     Content start {c};
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    int character {0};
+    bool ok {true};
 
-    /* get character from '' */
-    if (*++c)
-    {
-        /* end */
-        if (*c == '\'') {
-            Error::Fatal(start.Location() + "empty character constant" +
-                         start.Currline());
-        }
-        /* get escape character */
-        else if (*c == '\\') {
-            EscapeChar(c, &tok->char_literal);
-            if (*c != '\'') {
-                Error::Fatal(start.Location() + "Multi-character character constant" +
-                             start.Currline());
-            }
+    ++c;
+    if (*c == '\'') {
+        diags.Error(D_EMPTY_CHAR, start.Offset());
+        ++c;
+        return;
+    }
 
-            /* jump terminated character */
-            ++c;
-        }
-        /* normal character */
-        else {
-            if (*(c+1) != '\'') {
-                Error::Fatal(start.Location() + "Multi-character character constant" +
-                             start.Currline());
-            }
-            tok->char_literal = *c;
-            c += 2;
-        }
+    /* one character or escape sequence */
+    if (*c == '\\') {
+        ok = EscapeChar(c, &character);
+    } else if (*c && *c != '\n') {
+        character = *c;
+        ++c;
+    }
 
+    if (ok && *c == '\'') {
+        ++c;
+
+        std::shared_ptr<Token> tok {NewToken()};
         tok->type = TK_CHAR;
+        tok->char_literal = character;
         tokenlist.emplace_back(tok);
+        return;
+    }
+
+    /* bad escapes are already reported */
+    if (!SkipChar(c)) {
+        diags.Error(D_UNTERMINATED_CHAR, start.Offset());
+    } else if (ok) {
+        diags.Error(D_MULTI_CHAR, start.Offset());
     }
 }
 
-void Tokenizer::EscapeChar(Content& c, int *character)
+/* error recovery: skip the rest of a character constant, false if it has no closing ' */
+bool Tokenizer::SkipChar(Content& c)
+{
+    while (*c && *c != '\n')
+    {
+        if (*c == '\\' && *(c+1) && *(c+1) != '\n') {
+            c += 2;
+            continue;
+        }
+        if (*c == '\'') {
+            ++c;
+            return true;
+        }
+        ++c;
+    }
+
+    return false;
+}
+
+/*
+ * c is on the backslash and is left after the escape sequence, or on the
+ * character that makes it invalid. The end of the line or of the input
+ * is left for the caller to report as an unterminated constant.
+ */
+bool Tokenizer::EscapeChar(Content& c, int *character)
 {
     switch (*++c)
     {
@@ -533,8 +517,7 @@ void Tokenizer::EscapeChar(Content& c, int *character)
         ++c;
         break;
     case 'x':
-        HexChar(c, character);
-        break;
+        return HexChar(c, character);
     case '0':
     case '1':
     case '2':
@@ -543,88 +526,74 @@ void Tokenizer::EscapeChar(Content& c, int *character)
     case '5':
     case '6':
     case '7':
-        OctalChar(c, character);
-        break;
+        return OctalChar(c, character);
+    case '\0':
+    case '\n':
+        return false;
     default:
-        Error::Fatal(c.Location() + "unknown escape character \\" + *c + c.Currline());
+        diags.Error(D_UNKNOWN_ESCAPE, c.Offset(), *c);
+        return false;
     }
+
+    return true;
 }
 
-/* \23, \0, \777 */
-void Tokenizer::OctalChar(Content& c, int *octal)
+/* \0, \23, \377: up to 3 digits, the value must fit in an unsigned char */
+bool Tokenizer::OctalChar(Content& c, int *octal)
 {
     int cnt {0};
     int result {0};
-    int pow {1};
-    const char* start {c.Str()};
+    size_t offset {c.Offset()};
 
-    while (*c)
+    while (cnt < 3 && *c >= '0' && *c <= '7')
     {
-        /* octal 0-7 */
-        if (*c >= '0' && *c <= '7') {
-            cnt++;
-            ++c;
-
-            /* max 3 character */
-            if (cnt > 3) {
-                Error::Fatal(c.Location() + "multi-character character constant" + c.Currline());
-            }
-        }
-        /* terminated */
-        else if (*c == '\'') {
-            break;
-        } else {
-            Error::Fatal(c.Location() + "multi-character character constant" + c.Currline());
-        }
+        result = result * 8 + (*c - '0');
+        cnt++;
+        ++c;
     }
 
-    /* octal to dec */
-    while (cnt-- > 0)
-    {
-        result += ((pow) * (int)(*(start+cnt) - '0'));
-        pow <<= 3;
+    if (result > 0xff) {
+        diags.Error(D_ESCAPE_RANGE, offset);
+        return false;
     }
 
     *octal = result;
+
+    return true;
 }
 
-/* \xff, \x1234, \xAB */
-void Tokenizer::HexChar(Content& c, int *hex)
+/* \xff, \xAB: any number of digits, the value must fit in an unsigned char */
+bool Tokenizer::HexChar(Content& c, int *hex)
 {
-    int cnt{0};
+    int cnt {0};
     int result {0};
-    int pow {1};
-    const char* start {c+1};
-
-    /* if character is '\x' */
-    if (*++c == '\'') {
-        Error::Fatal(c.Location() + "used with no following hex digits" + c.Currline());
-    }
+    size_t offset {c.Offset()};
 
-    while (*c)
+    /* jump x */
+    ++c;
+    while (isxdigit(*c))
     {
-        /* 0-9, a-f, A-F */
-        if (isxdigit(*c)) {
-            cnt++;
-            ++c;
-        }
-        /* terminated character */
-        else if (*c == '\'') {
-            break;
-        } else {
-            /* character is not hex character */
-            Error::Fatal(c.Location() + "multi-character character constant" + c.Currline());
+        /* stop accumulating once out of range */
+        if (result <= 0xff) {
+            result = result * 16 + HexchToint(*c);
         }
+        cnt++;
+        ++c;
     }
 
-    /* hex to dec */
-    while (cnt-- > 0)
-    {
-        result += ((pow) * HexchToint(*(start+cnt)));
-        pow <<= 4;
+    if (cnt == 0) {
+        diags.Error(D_NO_HEX_DIGITS, offset);
+        return false;
+    }
+
+    if (result > 0xff) {
+        diags.Error(D_ESCAPE_RANGE, offset);
+        return false;
     }
 
     *hex = result;
+
+    return true;
 }
 
 int Tokenizer::HexchToint(char ch)
@@ -755,14 +724,15 @@ void Tokenizer::TokenPunct(Content& c)
         TokenRCubrckt(c);
         break;
     default:
-        Error::Fatal(c.Location() + "unknown punct: " + *c + c.Currline());
+        diags.Error(D_UNKNOWN_PUNCT, c.Offset(), *c);
+        ++c;
         break;
     }
 }
 
 void Tokenizer::TokenPlus(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     switch (*(++c))
     {
@@ -785,7 +755,7 @@ void Tokenizer::TokenPlus(Content& c)
 
 void Tokenizer::TokenSub(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     switch (*(++c))
     {
@@ -811,7 +781,7 @@ void Tokenizer::TokenSub(Content& c)
 
 void Tokenizer::TokenMul(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     switch (*(++c))
     {
@@ -829,7 +799,7 @@ void Tokenizer::TokenMul(Content& c)
 
 void Tokenizer::TokenDiv(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     switch (*(++c))
     {
@@ -847,7 +817,7 @@ void Tokenizer::TokenDiv(Content& c)
 
 void Tokenizer::TokenComp(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     switch (*(++c))
     {
@@ -865,7 +835,7 @@ void Tokenizer::TokenComp(Content& c)
 
 void Tokenizer::TokenNot(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     switch (*(++c))
     {
@@ -883,7 +853,7 @@ void Tokenizer::TokenNot(Content& c)
 
 void Tokenizer::TokenLower(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     switch (*(++c))
     {
@@ -909,7 +879,7 @@ void Tokenizer::TokenLower(Content& c)
 
 void Tokenizer::TokenGreater(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     switch (*(++c))
     {
@@ -935,7 +905,7 @@ void Tokenizer::TokenGreater(Content& c)
 
 void Tokenizer::TokenEqual(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     switch (*(++c))
     {
@@ -953,7 +923,7 @@ void Tokenizer::TokenEqual(Content& c)
 
 void Tokenizer::TokenAnd(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     switch (*(++c))
     {
@@ -975,7 +945,7 @@ void Tokenizer::TokenAnd(Content& c)
 
 void Tokenizer::TokenOr(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     switch (*(++c))
     {
@@ -997,7 +967,7 @@ void Tokenizer::TokenOr(Content& c)
 
 void Tokenizer::TokenXor(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     switch (*(++c))
     {
@@ -1015,17 +985,11 @@ void Tokenizer::TokenXor(Content& c)
 
 void Tokenizer::TokenNeg(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
-    switch (*(++c))
-    {
-    case '=':
-        tok->operate = O_NEGASSIGN;
-        ++c;
-        break;
-    default:
-        tok->operate = O_BITNEG;
-    }
+    /* ~= is not an operator, ~ and = are two tokens */
+    ++c;
+    tok->operate = O_BITNEG;
 
     tok->type = TK_OPEOR;
     tokenlist.emplace_back(tok);
@@ -1033,7 +997,7 @@ void Tokenizer::TokenNeg(Content& c)
 
 void Tokenizer::TokenCond(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     ++c;
     tok->operate = O_COND;
@@ -1043,7 +1007,7 @@ void Tokenizer::TokenCond(Content& c)
 
 void Tokenizer::TokenComma(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     ++c;
     tok->separator = S_COMMA;
@@ -1053,7 +1017,16 @@ void Tokenizer::TokenComma(Content& c)
 
 void Tokenizer::TokenDot(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
+
+    /* ... */
+    if (*(c+1) == '.' && *(c+2) == '.') {
+        c += 3;
+        tok->separator = S_ELLIPSIS;
+        tok->type = TK_SEPOR;
+        tokenlist.emplace_back(tok);
+        return;
+    }
 
     ++c;
     tok->separator = S_DOT;
@@ -1063,7 +1036,7 @@ void Tokenizer::TokenDot(Content& c)
 
 void Tokenizer::TokenColon(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     ++c;
     tok->separator = S_COLON;
@@ -1073,7 +1046,7 @@ void Tokenizer::TokenColon(Content& c)
 
 void Tokenizer::TokenEmiColon(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     ++c;
     tok->separator = S_EMICLON;
@@ -1083,7 +1056,7 @@ void Tokenizer::TokenEmiColon(Content& c)
 
 void Tokenizer::TokenLParet(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     ++c;
     tok->separator = S_LPARET;
@@ -1093,7 +1066,7 @@ void Tokenizer::TokenLParet(Content& c)
 
 void Tokenizer::TokenRParet(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     ++c;
     tok->separator = S_RPARET;
@@ -1103,7 +1076,7 @@ void Tokenizer::TokenRParet(Content& c)
 
 void Tokenizer::TokenLSqbrckt(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     ++c;
     tok->separator = S_LSQBRCKT;
@@ -1113,7 +1086,7 @@ void Tokenizer::TokenLSqbrckt(Content& c)
 
 void Tokenizer::TokenRSqbrckt(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     ++c;
     tok->separator = S_RSQBRCKT;
@@ -1123,7 +1096,7 @@ void Tokenizer::TokenRSqbrckt(Content& c)
 
 void Tokenizer::TokenLCubrckt(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     ++c;
     tok->separator = S_LCUBRCKT;
@@ -1133,7 +1106,7 @@ void Tokenizer::TokenLCubrckt(Content& c)
 
 void Tokenizer::TokenRCubrckt(Content& c)
 {
-    std::shared_ptr<Token> tok {std::make_shared<Token>()};
+    std::shared_ptr<Token> tok {NewToken()};
 
     ++c;
     tok->separator = S_RCUBRCKT;
@@ -0,0 +1,231 @@
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <glob.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "log.h"
+#include "files.h"
+#include "toolchain.h"
+
+namespace c89 {
+
+static const char *cache_magic = "c--toolchain 1";
+
+// directories whose contents decide the probe result
+static const char *probe_dirs[] = {
+    "/usr/lib/x86_64-linux-gnu",
+    "/usr/lib64",
+    "/usr/lib/gcc/x86_64*",
+    "/usr/lib64/gcc/x86_64*",
+};
+
+const Toolchain& Toolchain::Probe()
+{
+    static Toolchain tc;
+    static bool probed = false;
+
+    if (probed) {
+        return tc;
+    }
+    probed = true;
+
+    auto dir = Files::CacheDir();
+    auto key = CacheKey();
+    auto path = dir.empty() ? dir : dir + "/toolchain";
+
+    if (!path.empty() && tc.LoadCache(path, key)) {
+        return tc;
+    }
+
+    tc.gccversion = GetGccVersion();
+    tc.glibcrt = FindGlibCrt();
+    tc.gcclibcrt = FindGccLibCrt(tc.gccversion);
+
+    if (!path.empty()) {
+        tc.SaveCache(path, key);
+    }
+
+    return tc;
+}
+
+std::string Toolchain::FindGlibCrt()
+{
+    struct stat st;
+
+    if (!stat("/usr/lib/x86_64-linux-gnu/crti.o", &st)) {
+        return "/usr/lib/x86_64-linux-gnu";
+    }
+
+    if (!stat("/usr/lib64/crti.o", &st)) {
+        return "/usr/lib64";
+    }
+
+    Error::Fatal("Glibc Runtime Library not found");
+    return "";
+}
+
+std::string Toolchain::FindGccLibCrt(unsigned int v)
+{
+    glob_t buf;
+    std::string version, path;
+
+    if (v) {
+        version = std::to_string(v);
+    } else {
+        version = "*";
+    }
+
+    std::vector<std::string> paths {
+        "/usr/lib/gcc/x86_64*/" + version + "/crtbegin.o",
+        "/usr/lib64/gcc/x86_64*/" + version + "/crtbegin.o",
+    };
+
+    for (auto& s : paths)
+    {
+        if (glob(s.c_str(), 0, NULL, &buf)) {
+            continue;
+        }
+
+        if (buf.gl_pathc > 0) {
+            path = buf.gl_pathv[buf.gl_pathc - 1];
+            globfree(&buf);
+            return Files::DirName(path);
+        }
+
+        globfree(&buf);
+    }
+
+    Error::Fatal("Gcc Runtime Library not found");
+    return "";
+}
+
+unsigned int Toolchain::GetGccVersion()
+{
+    int n;
+    FILE *fp;
+    unsigned int version;
+
+    fp = popen("gcc -dumpversion 2>/dev/null", "r");
+    if (!fp) {
+        return 0;
+    }
+
+    n = fscanf(fp, "%u", &version);
+    pclose(fp);
+
+    if (n != 1) {
+        return 0;
+    }
+
+    return version;
+}
+
+/*
+ * "path:sec.nsec;" for every probed directory plus the gcc found in PATH,
+ * so installing or upgrading gcc/glibc invalidates the cache.
+ */
+std::string Toolchain::CacheKey()
+{
+    glob_t buf;
+    struct stat st;
+    std::string key, gcc;
+
+    auto append = [&key, &st](const char *path) {
+        if (!stat(path, &st)) {
+            key += std::string(path) + ":" + std::to_string(st.st_mtim.tv_sec) +
+                   "." + std::to_string(st.st_mtim.tv_nsec) + ";";
+        }
+    };
+
+    for (auto pattern : probe_dirs)
+    {
+        if (glob(pattern, GLOB_ONLYDIR, NULL, &buf)) {
+            continue;
+        }
+
+        for (size_t i = 0; i < buf.gl_pathc; i++)
+        {
+            append(buf.gl_pathv[i]);
+        }
+
+        globfree(&buf);
+    }
+
+    const char *env = getenv("PATH");
+    std::string paths = env ? env : "";
+    size_t last {0}, pos {0};
+
+    while (last <= paths.size())
+    {
+        pos = paths.find(':', last);
+        if (pos == paths.npos) {
+            pos = paths.size();
+        }
+
+        gcc = paths.substr(last, pos - last) + "/gcc";
+        if (!access(gcc.c_str(), X_OK)) {
+            append(gcc.c_str());
+            break;
+        }
+
+        last = pos + 1;
+    }
+
+    return key;
+}
+
+bool Toolchain::LoadCache(const std::string& path, const std::string& key)
+{
+    FILE *fp;
+    char line[4096];
+    std::vector<std::string> lines;
+
+    fp = fopen(path.c_str(), "r");
+    if (!fp) {
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), fp))
+    {
+        line[strcspn(line, "\n")] = '\0';
+        lines.emplace_back(line);
+    }
+    fclose(fp);
+
+    // magic, key, glibcrt, gcclibcrt, gccversion
+    if (lines.size() != 5 || lines[0] != cache_magic || lines[1] != key) {
+        return false;
+    }
+
+    glibcrt = lines[2];
+    gcclibcrt = lines[3];
+    gccversion = strtoul(lines[4].c_str(), NULL, 10);
+
+    return !glibcrt.empty() && !gcclibcrt.empty();
+}
+
+void Toolchain::SaveCache(const std::string& path, const std::string& key) const
+{
+    FILE *fp;
+    auto tmp = path + "." + std::to_string(getpid());
+
+    fp = fopen(tmp.c_str(), "w");
+    if (!fp) {
+        return;
+    }
+
+    fprintf(fp, "%s\n%s\n%s\n%s\n%u\n", cache_magic, key.c_str(),
+            glibcrt.c_str(), gcclibcrt.c_str(), gccversion);
+
+    // publish atomically, concurrent c-- runs may race on the cache
+    if (fclose(fp) || rename(tmp.c_str(), path.c_str())) {
+        unlink(tmp.c_str());
+    }
+}
+
+}
@@ -1,9 +1,9 @@
 int main (int argc, char **argv)
 {
 	char a = '\xff';
-	char a1 = '\777';
+	char a1 = '\377';
 	char a2 = '\0';
-	char a3 = '\xffab';
+	char a3 = '\xab';
 	char a4 = '\n';
 	char a5 = ' ';
 
@@ -0,0 +1,183 @@
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "files.h"
+#include "archive.h"
+#include "mappedfile.h"
+
+/*
+ * Archive symbol index cache: a table built from an archive must find
+ * its symbols, and a damaged cache must be rebuilt instead of used. A
+ * cache with no empty bucket used to make lookups of missing names spin.
+ */
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+typedef c89::ArchiveIndex::Header Header;
+
+std::string tmpdir = "/tmp/c--test-" + std::to_string(getpid());
+
+std::string Field(const std::string& value, size_t width)
+{
+    return value + std::string(width - value.size(), ' ');
+}
+
+void BigEndian(std::string& out, uint32_t v)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+    {
+        out += (char)(v >> shift);
+    }
+}
+
+// "/" symbol index only, members are never read by ArchiveIndex
+std::string MakeArchive()
+{
+    std::string body;
+
+    BigEndian(body, 3);
+    BigEndian(body, 100);
+    BigEndian(body, 200);
+    BigEndian(body, 300);
+    body += std::string("foo\0bar\0foo\0", 12);
+
+    return "!<arch>\n" + Field("/", 16) + Field("0", 12) + Field("0", 6) + Field("0", 6) +
+           Field("0", 8) + Field(std::to_string(body.size()), 10) + "`\n" + body;
+}
+
+std::string CacheFile()
+{
+    std::string dir = tmpdir + "/c--/archives";
+    std::string path;
+    DIR *d = opendir(dir.c_str());
+    struct dirent *ent;
+
+    while (d && (ent = readdir(d)))
+    {
+        if (ent->d_name[0] != '.') {
+            path = dir + "/" + ent->d_name;
+        }
+    }
+    if (d) {
+        closedir(d);
+    }
+
+    return path;
+}
+
+uint32_t* Buckets(std::string& image)
+{
+    Header *h = (Header *)&image[0];
+    size_t off = (sizeof(Header) + h->pathlen + 7) & ~(size_t)7;
+    return (uint32_t *)&image[off];
+}
+
+void Lookup(const std::string& arpath)
+{
+    c89::MappedFile ar;
+    c89::ArchiveIndex index;
+
+    CHECK(ar.Open(arpath));
+    CHECK(index.Load(arpath, ar));
+    CHECK(index.Find("foo") == 100);
+    CHECK(index.Find("bar") == 200);
+    CHECK(index.Find("missing") == c89::ArchiveIndex::npos);
+}
+
+// a cache patched by fn must be rebuilt, and lookups must still work
+void Corrupt(const char *name, const std::string& arpath, const std::string& good,
+             std::function<void(std::string&)> fn)
+{
+    std::string cachepath = CacheFile(), image = good, rebuilt;
+
+    fn(image);
+    CHECK(c89::Files::WriteFile(cachepath, image));
+
+    Lookup(arpath);
+
+    CHECK(c89::Files::ReadFile(cachepath, rebuilt));
+    if (rebuilt != good) {
+        fprintf(stderr, "damaged cache '%s' was not rebuilt\n", name);
+        failures++;
+    }
+}
+
+}
+
+int main()
+{
+    std::string arpath = tmpdir + "/libx.a", good;
+
+    setenv("XDG_CACHE_HOME", tmpdir.c_str(), 1);
+    mkdir(tmpdir.c_str(), 0755);
+    CHECK(c89::Files::WriteFile(arpath, MakeArchive()));
+
+    // built from the archive, then mapped from the cache
+    Lookup(arpath);
+    CHECK(!CacheFile().empty());
+    CHECK(c89::Files::ReadFile(CacheFile(), good));
+    Lookup(arpath);
+
+    Corrupt("full", arpath, good, [](std::string& image) {
+        Header *h = (Header *)&image[0];
+        uint32_t *b = Buckets(image);
+        for (uint32_t i = 0; i < h->nbuckets; i++)
+        {
+            b[i] = i % h->nentries + 1;
+        }
+    });
+
+    Corrupt("nentries", arpath, good, [](std::string& image) {
+        Header *h = (Header *)&image[0];
+        h->nentries = h->nbuckets;
+    });
+
+    Corrupt("bucket", arpath, good, [](std::string& image) {
+        Header *h = (Header *)&image[0];
+        Buckets(image)[0] = h->nentries + 1;
+    });
+
+    Corrupt("nbuckets", arpath, good, [](std::string& image) {
+        ((Header *)&image[0])->nbuckets = 12;
+    });
+
+    Corrupt("stroff", arpath, good, [](std::string& image) {
+        ((Header *)&image[0])->stroff = image.size() + 1;
+    });
+
+    Corrupt("truncated", arpath, good, [](std::string& image) {
+        image.resize(sizeof(Header) / 2);
+    });
+
+    unlink(CacheFile().c_str());
+    unlink(arpath.c_str());
+    rmdir((tmpdir + "/c--/archives").c_str());
+    rmdir((tmpdir + "/c--").c_str());
+    rmdir(tmpdir.c_str());
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
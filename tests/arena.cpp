@@ -0,0 +1,103 @@
+#include <string>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include "arena.h"
+
+/*
+ * Arena: allocations are aligned, never overlap and stay inside the
+ * mapped chunks, also when the alignment is larger than what is left of
+ * the current chunk.
+ */
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+bool Aligned(const void *p, size_t align)
+{
+    return (uintptr_t)p % align == 0;
+}
+
+// fill the first chunk almost to the end, then ask for more alignment
+// than is left: the aligned pointer lies past the end of the chunk
+void LargeAlign(size_t align)
+{
+    c89::Arena arena(4096);
+
+    char *a = (char *)arena.Allocate(4000, 1);
+    memset(a, 1, 4000);
+
+    char *b = (char *)arena.Allocate(64, align);
+    CHECK(Aligned(b, align));
+    CHECK(b + 64 <= a || b >= a + 4000);
+    memset(b, 2, 64);
+
+    char *c = (char *)arena.Allocate(16, 16);
+    CHECK(c + 16 <= b || c >= b + 64);
+    memset(c, 3, 16);
+}
+
+void Sequence()
+{
+    c89::Arena arena;
+    char *last = nullptr;
+
+    // across several chunks, including one bigger than any chunk
+    for (size_t i = 0; i < 2000; i++)
+    {
+        size_t size = i == 1000 ? 3 * c89::Arena::maxchunk : 1 + i % 200;
+        size_t align = (size_t)1 << (i % 7);
+        char *p = (char *)arena.Allocate(size, align);
+
+        CHECK(Aligned(p, align));
+        memset(p, (int)i, size);
+        CHECK(p != last);
+        last = p;
+    }
+}
+
+void List()
+{
+    c89::Arena arena;
+    c89::ArenaList<std::string> list {c89::ArenaAllocator<std::string>(arena)};
+
+    for (int i = 0; i < 1000; i++)
+    {
+        list.emplace_back(std::to_string(i));
+    }
+
+    int i = 0;
+    for (auto& s : list)
+    {
+        CHECK(s == std::to_string(i++));
+    }
+    CHECK(i == 1000);
+}
+
+}
+
+int main()
+{
+    LargeAlign(1 << 13);
+    LargeAlign(1 << 16);
+    LargeAlign(1 << 20);
+    Sequence();
+    List();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
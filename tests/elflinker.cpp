@@ -0,0 +1,333 @@
+#include <elf.h>
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <functional>
+
+#include <unistd.h>
+
+#include "files.h"
+#include "process.h"
+#include "parallel.h"
+#include "elflinker.h"
+
+/*
+ * ElfLinker on -nostdlib objects assembled by as: the linked program
+ * must run and exit with the status it computes, damaged objects must
+ * be rejected with a reason instead of read out of bounds, and linking
+ * with many threads must give the same bytes as linking with one.
+ */
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+std::string TmpPath(const std::string& name)
+{
+    return "/tmp/c--test-" + std::to_string(getpid()) + "-" + name;
+}
+
+// _start exits with compute(), which reads data through every kind of
+// relocation the linker supports for plain static code
+const char *start_s =
+    "    .text\n"
+    "    .globl _start\n"
+    "_start:\n"
+    "    call compute\n"
+    "    mov %eax, %edi\n"
+    "    mov $60, %eax\n"
+    "    syscall\n";
+
+const char *compute_s =
+    "    .text\n"
+    "    .globl compute\n"
+    "compute:\n"
+    "    mov value(%rip), %eax\n"
+    "    mov ptr(%rip), %rcx\n"
+    "    add (%rcx), %eax\n"
+    "    mov counter@GOTPCREL(%rip), %rcx\n"
+    "    movl $5, (%rcx)\n"
+    "    add (%rcx), %eax\n"
+    "    add shared(%rip), %eax\n"
+    "    ret\n"
+    "    .data\n"
+    "    .globl value\n"
+    "value:\n"
+    "    .long 35\n"
+    "two:\n"
+    "    .long 2\n"
+    "ptr:\n"
+    "    .quad two\n"
+    "    .bss\n"
+    "counter:\n"
+    "    .zero 4\n"
+    "    .comm shared, 8, 8\n";
+
+bool Assemble(const std::string& name, const char *text, std::string& obj)
+{
+    std::string src = TmpPath(name + ".s");
+    obj = TmpPath(name + ".o");
+
+    if (!c89::Files::WriteFile(src, text)) {
+        return false;
+    }
+
+    int status = c89::Process::Run({"as", "-o", obj.c_str(), src.c_str(), nullptr});
+    unlink(src.c_str());
+
+    return status == 0;
+}
+
+template <typename T>
+T* At(std::string& image, uint64_t offset)
+{
+    return (T *)&image[offset];
+}
+
+Elf64_Shdr* Section(std::string& image, uint32_t type)
+{
+    Elf64_Ehdr *ehdr = At<Elf64_Ehdr>(image, 0);
+
+    for (uint32_t i = 0; i < ehdr->e_shnum; i++)
+    {
+        Elf64_Shdr *sh = At<Elf64_Shdr>(image, ehdr->e_shoff + i * sizeof(Elf64_Shdr));
+        if (sh->sh_type == type) {
+            return sh;
+        }
+    }
+
+    return nullptr;
+}
+
+Elf64_Sym* Symbol(std::string& image, const char *name)
+{
+    Elf64_Ehdr *ehdr = At<Elf64_Ehdr>(image, 0);
+    Elf64_Shdr *symsec = Section(image, SHT_SYMTAB);
+    Elf64_Shdr *strsec = At<Elf64_Shdr>(image, ehdr->e_shoff + symsec->sh_link * sizeof(Elf64_Shdr));
+
+    for (uint64_t off = 0; off < symsec->sh_size; off += sizeof(Elf64_Sym))
+    {
+        Elf64_Sym *sym = At<Elf64_Sym>(image, symsec->sh_offset + off);
+        if (!strcmp(&image[strsec->sh_offset + sym->st_name], name)) {
+            return sym;
+        }
+    }
+
+    return nullptr;
+}
+
+void Run(const std::string& start, const std::string& compute)
+{
+    std::string exe = TmpPath("a.out");
+    std::string why;
+
+    CHECK(c89::ElfLinker::Link(exe, {start, compute}, &why));
+    CHECK(why.empty());
+    CHECK(c89::Process::Run({exe.c_str(), nullptr}) == 42);
+    unlink(exe.c_str());
+}
+
+// a copy of obj patched by fn must be rejected with a reason
+void Corrupt(const char *name, const std::string& start, const std::string& obj,
+             std::function<void(std::string&)> fn)
+{
+    std::string image, why;
+    std::string bad = TmpPath(std::string(name) + ".o");
+    std::string exe = TmpPath("bad.out");
+
+    CHECK(c89::Files::ReadFile(obj, image));
+    fn(image);
+    CHECK(c89::Files::WriteFile(bad, image));
+
+    if (c89::ElfLinker::Link(exe, {start, bad}, &why)) {
+        fprintf(stderr, "corrupt object '%s' was linked\n", name);
+        failures++;
+    } else if (why.empty()) {
+        fprintf(stderr, "corrupt object '%s' was rejected without a reason\n", name);
+        failures++;
+    }
+
+    CHECK(access(exe.c_str(), F_OK) != 0);
+    unlink(exe.c_str());
+    unlink(bad.c_str());
+}
+
+// weak, common and strong definitions of the same names spread over
+// enough objects that resolution runs on several threads at once
+std::vector<std::string> ConflictObjects()
+{
+    std::vector<std::string> objs;
+    std::string obj;
+
+    auto add = [&](const std::string& name, const std::string& text) {
+        if (Assemble(name, text.c_str(), obj)) {
+            objs.push_back(obj);
+        }
+    };
+
+    add("c-start",
+        "    .text\n"
+        "    .globl _start\n"
+        "_start:\n"
+        "    call hook\n"
+        "    add mixed(%rip), %eax\n"
+        "    call weakonly\n"
+        "    mov %eax, %edi\n"
+        "    mov $60, %eax\n"
+        "    syscall\n");
+
+    for (int i = 0; i < 24; i++)
+    {
+        std::string n = std::to_string(i);
+        std::string text =
+            "    .text\n"
+            "    .globl f" + n + "\n"
+            "f" + n + ":\n"
+            "    lea buf(%rip), %rax\n"
+            "    mov local" + n + "(%rip), %rcx\n"
+            "    call weakonly\n"
+            "    ret\n"
+            "    .data\n"
+            "local" + n + ":\n"
+            "    .quad buf + " + n + "\n"
+            "    .comm buf, " + std::to_string(8 * (i % 5 + 1)) + ", " +
+                                std::to_string(1 << (i % 6)) + "\n"
+            "    .comm mixed, 8, 8\n";
+
+        // the strong definitions sit in the middle of the command line
+        if (i == 13) {
+            text += "    .text\n"
+                    "    .globl hook\n"
+                    "hook:\n"
+                    "    mov $40, %eax\n"
+                    "    ret\n"
+                    "    .data\n"
+                    "    .globl mixed\n"
+                    "mixed:\n"
+                    "    .quad 1\n";
+        } else if (i % 3 == 0) {
+            text += "    .text\n"
+                    "    .weak hook\n"
+                    "hook:\n"
+                    "    mov $" + n + ", %eax\n"
+                    "    ret\n";
+        }
+
+        // weak against weak goes to the first object
+        if (i % 4 == 1) {
+            text += "    .text\n"
+                    "    .weak weakonly\n"
+                    "weakonly:\n"
+                    "    add $" + std::to_string(i == 1 ? 1 : 100) + ", %eax\n"
+                    "    ret\n";
+        }
+
+        add("c-" + n, text);
+    }
+
+    return objs;
+}
+
+void Deterministic()
+{
+    std::vector<std::string> objs = ConflictObjects();
+    std::string serial = TmpPath("serial.out"), parallel = TmpPath("parallel.out");
+    std::string a, b;
+
+    CHECK(objs.size() == 25);
+
+    c89::Parallel::SetThreads(1);
+    CHECK(c89::ElfLinker::Link(serial, objs));
+    CHECK(c89::Process::Run({serial.c_str(), nullptr}) == 42);
+    CHECK(c89::Files::ReadFile(serial, a));
+
+    // races would show up only now and then
+    c89::Parallel::SetThreads(8);
+    for (int i = 0; i < 20; i++)
+    {
+        CHECK(c89::ElfLinker::Link(parallel, objs));
+        CHECK(c89::Files::ReadFile(parallel, b));
+        CHECK(a == b);
+    }
+    c89::Parallel::SetThreads(0);
+
+    unlink(serial.c_str());
+    unlink(parallel.c_str());
+    for (auto& obj : objs)
+    {
+        unlink(obj.c_str());
+    }
+}
+
+}
+
+int main()
+{
+    std::string start, compute;
+
+    // nothing to link with, not a failure of the linker
+    if (!Assemble("start", start_s, start) || !Assemble("compute", compute_s, compute)) {
+        fprintf(stderr, "as is not usable, skipped\n");
+        unlink(start.c_str());
+        unlink(compute.c_str());
+        return 77;
+    }
+
+    Run(start, compute);
+
+    Corrupt("global-shndx", start, compute, [](std::string& image) {
+        Symbol(image, "compute")->st_shndx = 0x1234;
+    });
+
+    Corrupt("local-shndx", start, compute, [](std::string& image) {
+        Symbol(image, "two")->st_shndx = 0x1234;
+    });
+
+    Corrupt("rela-symbol", start, compute, [](std::string& image) {
+        Elf64_Rela *r = At<Elf64_Rela>(image, Section(image, SHT_RELA)->sh_offset);
+        r->r_info = ELF64_R_INFO(0xffffff, ELF64_R_TYPE(r->r_info));
+    });
+
+    Corrupt("rela-offset", start, compute, [](std::string& image) {
+        Elf64_Rela *r = At<Elf64_Rela>(image, Section(image, SHT_RELA)->sh_offset);
+        r->r_offset = UINT64_MAX - 1;
+    });
+
+    Corrupt("section-size", start, compute, [](std::string& image) {
+        Elf64_Shdr *sh = Section(image, SHT_PROGBITS);
+        sh->sh_size = image.size();
+    });
+
+    // offset + size wraps around to a small value
+    Corrupt("section-wrap", start, compute, [](std::string& image) {
+        Elf64_Shdr *sh = Section(image, SHT_PROGBITS);
+        sh->sh_size = UINT64_MAX - sh->sh_offset + 2;
+    });
+
+    Corrupt("truncated", start, compute, [](std::string& image) {
+        image.resize(image.size() / 2);
+    });
+
+    unlink(start.c_str());
+    unlink(compute.c_str());
+
+    Deterministic();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
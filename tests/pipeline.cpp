@@ -0,0 +1,124 @@
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <cstdio>
+#include <cstddef>
+
+#include "parallel.h"
+#include "pipeline.h"
+
+/*
+ * Pipeline: every item passes through every stage exactly once, after
+ * the stage before it, and serial stages see the items in index order,
+ * whatever the number of threads.
+ */
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+const size_t nstages = 4;
+
+struct Counts
+{
+    explicit Counts(size_t n) : runs(n * nstages), bad(0) {}
+
+    std::vector<std::atomic<int>> runs;    // item * nstages + stage
+    std::atomic<int> bad;                  // stage ran before the previous one
+    std::mutex lock;
+    std::vector<size_t> order[nstages];    // serial stages only
+};
+
+void Stage(Counts& c, size_t stage, size_t item, bool serial)
+{
+    if (stage > 0 && c.runs[item * nstages + stage - 1] != 1) {
+        c.bad++;
+    }
+
+    c.runs[item * nstages + stage]++;
+
+    if (serial) {
+        std::lock_guard<std::mutex> lock(c.lock);
+        c.order[stage].push_back(item);
+    }
+}
+
+void Check(Counts& c, size_t n)
+{
+    CHECK(c.bad == 0);
+
+    for (size_t i = 0; i < n * nstages; i++)
+    {
+        if (c.runs[i] != 1) {
+            fprintf(stderr, "item %zu ran %d times in stage %zu\n",
+                    i / nstages, (int)c.runs[i], i % nstages);
+            failures++;
+        }
+    }
+
+    for (size_t stage : {1, 3})
+    {
+        CHECK(c.order[stage].size() == n);
+        for (size_t i = 0; i < c.order[stage].size(); i++)
+        {
+            if (c.order[stage][i] != i) {
+                fprintf(stderr, "serial stage %zu saw item %zu at %zu\n", stage, c.order[stage][i], i);
+                failures++;
+                break;
+            }
+        }
+        c.order[stage].clear();
+    }
+
+    for (auto& r : c.runs)
+    {
+        r = 0;
+    }
+}
+
+// parallel, serial, parallel, serial; run twice on the same pipeline
+void Run(unsigned int threads, size_t n)
+{
+    c89::Parallel::SetThreads(threads);
+
+    Counts c(n);
+    c89::Pipeline pipeline;
+
+    pipeline.AddStage("a", [&](size_t i) { Stage(c, 0, i, false); });
+    pipeline.AddSerialStage("b", [&](size_t i) { Stage(c, 1, i, true); });
+    pipeline.AddStage("c", [&](size_t i) { Stage(c, 2, i, false); });
+    pipeline.AddSerialStage("d", [&](size_t i) { Stage(c, 3, i, true); });
+
+    pipeline.Run(n);
+    Check(c, n);
+
+    pipeline.Run(n);
+    Check(c, n);
+}
+
+}
+
+int main()
+{
+    for (unsigned int threads : {1, 2, 8})
+    {
+        Run(threads, 0);
+        Run(threads, 1);
+        Run(threads, 1000);
+    }
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,350 @@
+#include <string>
+#include <thread>
+#include <vector>
+#include <random>
+#include <functional>
+#include <initializer_list>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "files.h"
+#include "remote.h"
+#include "compress.h"
+#include "argument.h"
+
+/*
+ * Distributed compilation pieces: LZ4 blocks must round-trip and damaged
+ * ones must be refused, frames must survive the channel and bad ones be
+ * refused, and the scheduler must hand a job to a worker and report the
+ * jobs a worker refuses so they are compiled locally.
+ */
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+std::string TmpPath(const std::string& name)
+{
+    return "/tmp/c--test-" + std::to_string(getpid()) + "-" + name;
+}
+
+const char *valid_s =
+    "    .text\n"
+    "    .globl f\n"
+    "f:\n"
+    "    lea 3(%rdi,%rdi,2), %eax\n"
+    "    ret\n";
+
+const char *incbin_s =
+    "    .data\n"
+    "    .incbin \"/etc/passwd\"\n";
+
+std::string Random(size_t len, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    std::string s(len, '\0');
+
+    for (auto& c : s)
+    {
+        c = (char)rng();
+    }
+
+    return s;
+}
+
+// assembly like text, with long matches and long literal runs
+std::string Repetitive(size_t len)
+{
+    std::string s;
+
+    for (size_t i = 0; s.size() < len; i++)
+    {
+        s += "    movq " + std::to_string(i % 97 * 8) + "(%rbp), %rax\n";
+        if (i % 50 == 0) {
+            s += Random(300, i);
+        }
+        if (i % 200 == 0) {
+            s += std::string(1000, ' ');
+        }
+    }
+    s.resize(len);
+
+    return s;
+}
+
+bool Decode(std::initializer_list<unsigned char> bytes, size_t rawsize)
+{
+    std::string block(bytes.begin(), bytes.end()), out(rawsize, '\0');
+    return c89::Lz4::Decompress(block.data(), block.size(), &out[0], rawsize);
+}
+
+bool RoundTrip(const std::string& raw, std::string& block)
+{
+    std::string out(raw.size(), '\0');
+
+    c89::Lz4::Compress(raw.data(), raw.size(), block);
+    return c89::Lz4::Decompress(block.data(), block.size(), &out[0], out.size()) && out == raw;
+}
+
+void Blocks()
+{
+    std::string block;
+    std::vector<std::string> inputs = {
+        "", "a", "abcdabcdabcd", std::string(13, 'x'), std::string(100000, 'x'),
+        Repetitive(1 << 20), Random(70000, 1),
+    };
+
+    for (const auto& raw : inputs)
+    {
+        CHECK(RoundTrip(raw, block));
+    }
+
+    std::string raw = Repetitive(8192);
+    CHECK(RoundTrip(raw, block));
+    CHECK(block.size() < raw.size() / 2);
+
+    std::string out(raw.size(), '\0');
+
+    // every prefix is short of the output
+    for (size_t len = 0; len < block.size(); len++)
+    {
+        CHECK(!c89::Lz4::Decompress(block.data(), len, &out[0], out.size()));
+    }
+
+    // a block that expands to more or less than expected
+    std::string big(raw.size() + 1, '\0');
+    CHECK(!c89::Lz4::Decompress(block.data(), block.size(), &big[0], big.size()));
+    CHECK(!c89::Lz4::Decompress(block.data(), block.size(), &out[0], out.size() - 1));
+
+    // literals past the end of the block, then past the output
+    CHECK(!Decode({0xf0, 200, 'a', 'b', 'c'}, 300));
+    CHECK(!Decode({0x40, 'a', 'b', 'c', 'd'}, 3));
+
+    // match offsets of 0 and before the start of the output
+    CHECK(Decode({0x10, 'a', 1, 0, 0x10, 'b'}, 6));
+    CHECK(!Decode({0x10, 'a', 0, 0, 0x10, 'b'}, 6));
+    CHECK(!Decode({0x10, 'a', 2, 0, 0x10, 'b'}, 6));
+
+    // a match longer than the output, and one cut off in its length
+    CHECK(!Decode({0x1f, 'a', 1, 0, 0xff, 0x10}, 100));
+    CHECK(!Decode({0x1f, 'a', 1, 0, 0xff}, 300));
+
+    // garbage must be refused or decoded in bounds, never read or written past them
+    for (unsigned seed = 0; seed < 2000; seed++)
+    {
+        std::string junk = Random(1 + seed % 64, seed);
+        std::string dst(seed % 128, '\0');
+        c89::Lz4::Decompress(junk.data(), junk.size(), &dst[0], dst.size());
+    }
+
+    // single damaged bytes
+    for (size_t i = 0; i < block.size(); i++)
+    {
+        std::string bad = block;
+        bad[i] ^= 0x5a;
+        c89::Lz4::Decompress(bad.data(), bad.size(), &out[0], out.size());
+    }
+}
+
+void SendRaw(int fd, const void *data, size_t len)
+{
+    CHECK(write(fd, data, len) == (ssize_t)len);
+}
+
+void Channels()
+{
+    int sv[2];
+    c89::Frame f;
+    std::string name;
+
+    CHECK(!socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    {
+        c89::Channel a(sv[0]), b(sv[1]);
+        std::string big = Repetitive(3 << 20), noise = Random(100000, 7);
+
+        // large frames do not fit in the socket buffer
+        std::thread sender([&]() {
+            CHECK(a.Send(c89::R_ASSEMBLE, 0, "big.s", big.data(), big.size()));
+            CHECK(a.Send(c89::R_OBJECT, 0, "noise.o", noise.data(), noise.size()));
+            CHECK(a.Send(c89::R_FAILED, 0, "", nullptr, 0));
+        });
+
+        CHECK(b.Receive(f, name));
+        CHECK(f.kind == c89::R_ASSEMBLE && name == "big.s" && b.Payload() == big);
+        CHECK(f.size < f.rawsize);
+
+        CHECK(b.Receive(f, name));
+        CHECK(f.kind == c89::R_OBJECT && name == "noise.o" && b.Payload() == noise);
+        CHECK(f.size == f.rawsize);
+
+        CHECK(b.Receive(f, name));
+        CHECK(f.kind == c89::R_FAILED && name.empty() && b.Payload().empty());
+
+        sender.join();
+    }
+
+    auto refused = [&](const char *what, std::function<void(int)> fn) {
+        int fds[2];
+        CHECK(!socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+        c89::Channel ch(fds[1]);
+
+        fn(fds[0]);
+        close(fds[0]);
+
+        if (ch.Receive(f, name)) {
+            fprintf(stderr, "bad frame '%s' was received\n", what);
+            failures++;
+        }
+    };
+
+    c89::Frame good;
+    memset(&good, 0, sizeof(good));
+    memcpy(good.magic, "C--R", 4);
+    good.version = 1;
+    good.kind = c89::R_OBJECT;
+    good.flags = 0;
+    good.namelen = 1;
+    good.rawsize = 100;
+    good.size = 100;
+
+    refused("magic", [&](int fd) {
+        c89::Frame h = good;
+        memcpy(h.magic, "ELF!", 4);
+        SendRaw(fd, &h, sizeof(h));
+        SendRaw(fd, std::string(101, 'x').data(), 101);
+    });
+
+    refused("version", [&](int fd) {
+        c89::Frame h = good;
+        h.version = 2;
+        SendRaw(fd, &h, sizeof(h));
+        SendRaw(fd, std::string(101, 'x').data(), 101);
+    });
+
+    refused("header", [&](int fd) {
+        SendRaw(fd, &good, sizeof(good) / 2);
+    });
+
+    refused("payload", [&](int fd) {
+        SendRaw(fd, &good, sizeof(good));
+        SendRaw(fd, std::string(50, 'x').data(), 50);
+    });
+
+    refused("size", [&](int fd) {
+        c89::Frame h = good;
+        h.size = h.rawsize + 1;
+        SendRaw(fd, &h, sizeof(h));
+        SendRaw(fd, std::string(102, 'x').data(), 102);
+    });
+
+    refused("rawsize", [&](int fd) {
+        c89::Frame h = good;
+        h.rawsize = h.size = UINT64_MAX;
+        SendRaw(fd, &h, sizeof(h));
+    });
+
+    // compressed payload that does not expand to rawsize
+    refused("compressed", [&](int fd) {
+        c89::Frame h = good;
+        h.size = 10;
+        SendRaw(fd, &h, sizeof(h));
+        SendRaw(fd, std::string(11, 'x').data(), 11);
+    });
+}
+
+// R_OBJECT or R_FAILED of a job sent straight to a worker
+int Job(const char *text, uint32_t flags)
+{
+    int sv[2];
+    c89::Frame f;
+    std::string name;
+
+    CHECK(!socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+    std::thread worker(&c89::Worker::Serve, sv[1]);
+
+    int kind = -1;
+    {
+        c89::Channel ch(sv[0]);
+        if (ch.Send(c89::R_ASSEMBLE, flags, "job.s", text, strlen(text)) && ch.Receive(f, name)) {
+            kind = f.kind;
+        }
+    }
+    worker.join();
+
+    return kind;
+}
+
+bool Workers()
+{
+    if (Job(valid_s, 0) != c89::R_OBJECT) {
+        return false;
+    }
+
+    CHECK(Job(valid_s, 1) == c89::R_FAILED);
+    CHECK(Job(incbin_s, 0) == c89::R_FAILED);
+    CHECK(Job("    .text\n    bogus %rax\n", 0) == c89::R_FAILED);
+
+    // the unreachable worker is skipped with a warning
+    c89::CcArg arg;
+    arg.workers = {"local:1", "127.0.0.1:1"};
+    c89::Scheduler *sched = c89::Scheduler::Get(arg);
+    CHECK(sched);
+    if (!sched) {
+        return true;
+    }
+
+    std::string good = TmpPath("good.s"), bad = TmpPath("bad.s"), obj = TmpPath("job.o");
+    std::string image;
+    CHECK(c89::Files::WriteFile(good, valid_s));
+    CHECK(c89::Files::WriteFile(bad, incbin_s));
+
+    CHECK(sched->Assemble(good, obj));
+    CHECK(c89::Files::ReadFile(obj, image) && !image.compare(0, 4, "\177ELF"));
+    unlink(obj.c_str());
+
+    // the worker is still used after a refused job
+    CHECK(!sched->Assemble(bad, obj));
+    CHECK(access(obj.c_str(), F_OK) != 0);
+    CHECK(sched->Assemble(good, obj));
+
+    unlink(obj.c_str());
+    unlink(good.c_str());
+    unlink(bad.c_str());
+
+    return true;
+}
+
+}
+
+int main()
+{
+    Blocks();
+    Channels();
+
+    // jobs need as
+    bool ran = Workers();
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    if (!ran) {
+        fprintf(stderr, "as is not usable, workers skipped\n");
+        return 77;
+    }
+
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <functional>
+
+#include <unistd.h>
+
+#include "argument.h"
+#include "files.h"
+#include "tokenize.h"
+#include "tokenfile.h"
+
+/*
+ * .tok round trips: Write() then Open() must give back the tokens the
+ * tokenizer produced, and Open() must reject damaged files without
+ * reading outside of them.
+ */
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+typedef c89::TokenFile::Header Header;
+
+std::string TmpPath(const char *name)
+{
+    return "/tmp/c--test-" + std::to_string(getpid()) + "-" + name + ".tok";
+}
+
+bool Same(const c89::Token& a, const c89::Token& b)
+{
+    if (a.type != b.type || a.offset != b.offset || a.length != b.length) {
+        return false;
+    }
+
+    switch (a.type)
+    {
+    case c89::TK_IDENT:
+        return a.ident_name == b.ident_name;
+    case c89::TK_STR:
+        return a.string_literal == b.string_literal;
+    case c89::TK_OPEOR:
+        return a.operate == b.operate;
+    case c89::TK_SEPOR:
+        return a.separator == b.separator;
+    case c89::TK_NUM:
+        return a.numtype == b.numtype &&
+               !memcmp(&a.number_literal, &b.number_literal, sizeof(a.number_literal));
+    case c89::TK_CHAR:
+        return a.char_literal == b.char_literal;
+    }
+
+    return false;
+}
+
+void RoundTrip(const char *name, const std::string& src)
+{
+    c89::CcArg arg;
+    c89::Tokenizer toks;
+    std::string path = TmpPath(name);
+
+    toks.Tokenize(arg, name, src);
+    CHECK(toks.diags.Count() == 0);
+    CHECK(c89::TokenFile::Write(path, toks.tokenlist, src));
+
+    c89::TokenFile tf;
+    CHECK(tf.Open(path));
+    unlink(path.c_str());
+
+    CHECK(tf.Count() == toks.tokenlist.size());
+    CHECK(tf.Source() == src);
+
+    c89::Tokenizer loaded;
+    loaded.Load(tf);
+    CHECK(loaded.tokenlist.size() == toks.tokenlist.size());
+
+    auto a = toks.tokenlist.begin();
+    auto b = loaded.tokenlist.begin();
+    for (; a != toks.tokenlist.end() && b != loaded.tokenlist.end(); ++a, ++b)
+    {
+        CHECK(Same(**a, **b));
+    }
+}
+
+// a valid file with its header patched by fn must not open
+void Corrupt(const char *name, std::function<void(std::string&, Header&)> fn)
+{
+    c89::CcArg arg;
+    c89::Tokenizer toks;
+    std::string path = TmpPath(name);
+    std::string src = "int main() { return x + 'a' + \"str\"[0] + 1.5; }\n";
+    std::string image;
+
+    toks.Tokenize(arg, name, src);
+    CHECK(c89::TokenFile::Write(path, toks.tokenlist, src));
+    CHECK(c89::Files::ReadFile(path, image));
+
+    Header h;
+    memcpy(&h, image.data(), sizeof(h));
+    fn(image, h);
+    if (image.size() >= sizeof(h)) {
+        memcpy(&image[0], &h, sizeof(h));
+    }
+    CHECK(c89::Files::WriteFile(path, image));
+
+    c89::TokenFile tf;
+    if (tf.Open(path)) {
+        fprintf(stderr, "corrupt file '%s' was accepted\n", name);
+        failures++;
+    }
+    unlink(path.c_str());
+}
+
+}
+
+int main()
+{
+    RoundTrip("empty", "");
+    RoundTrip("tokens",
+              "static unsigned long f(int a, char *s)\n"
+              "{\n"
+              "    s[0] = '\\n' + '\\x41' + '\\101';\n"
+              "    a <<= 3; a >>= 1; a->b; a ? a : !a;\n"
+              "    return 0x10UL + 017 + 42L + 1.5 + 2.0e3f + .5L + sizeof(\"a\\\"b\");\n"
+              "}\n");
+    RoundTrip("dedup", "x x x \"s\" \"s\" y");
+
+    Corrupt("truncated", [](std::string& image, Header&) { image.resize(20); });
+    Corrupt("magic", [](std::string&, Header& h) { h.magic[3] = 'X'; });
+    Corrupt("version", [](std::string&, Header& h) { h.version++; });
+    Corrupt("misaligned", [](std::string&, Header& h) { h.tokoff += 8; });
+    Corrupt("ntokens", [](std::string&, Header& h) { h.ntokens += 1; });
+    Corrupt("ntokens-overflow", [](std::string&, Header& h) { h.ntokens = UINT64_MAX / 40 + 1; });
+    Corrupt("strsize", [](std::string&, Header& h) { h.strsize = UINT64_MAX; });
+    Corrupt("srcoff", [](std::string&, Header& h) { h.srcoff--; });
+    Corrupt("srcsize", [](std::string& image, Header&) { image += "extra"; });
+
+    // tokoff past the end made f->size - tokoff wrap around
+    Corrupt("tokoff-wrap", [](std::string& image, Header& h) {
+        h.tokoff = (uint64_t)1 << 63;
+        h.ntokens = 0;
+        h.stroff = h.srcoff = h.tokoff;
+        h.strsize = 0;
+        h.srcsize = image.size() - h.tokoff;
+    });
+
+    Corrupt("record-string", [](std::string& image, Header& h) {
+        c89::TokenFile::Record r;
+        memcpy(&r, &image[h.tokoff], sizeof(r));
+        r.str = h.strsize;
+        r.strlen = 1;
+        memcpy(&image[h.tokoff], &r, sizeof(r));
+    });
+
+    Corrupt("record-source", [](std::string& image, Header& h) {
+        c89::TokenFile::Record r;
+        memcpy(&r, &image[h.tokoff], sizeof(r));
+        r.offset = h.srcsize;
+        r.length = 1;
+        memcpy(&image[h.tokoff], &r, sizeof(r));
+    });
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+
+    return 0;
+}